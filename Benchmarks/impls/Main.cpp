@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    Command-line benchmarks for the DSP code used by the other targets.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "RenderPoolBenchmark.h"
+#include "InterpolationBenchmark.h"
+#include "TableSynthesisBenchmark.h"
+#include "UnisonBenchmark.h"
+#include "BlockSineBenchmark.h"
+#include "VoiceAllocationBenchmark.h"
+#include "ConvolutionBenchmark.h"
+#include "DistortionBenchmark.h"
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ConsoleApplication app;
+
+    app.addHelpCommand ("--help|-h", "Usage: Benchmarks <command> [options]", true);
+
+    app.addCommand ({ "--render-pool",
+                      "--render-pool [--oscillators=N] [--block-size=N] [--blocks=N] [--max-threads=N]",
+                      "Measures how the WaveTable oscillator bank scales with render threads.",
+                      {},
+                      RenderPoolBenchmark::run });
+
+    app.addCommand ({ "--interpolation",
+                      "--interpolation [--oscillators=N] [--block-size=N] [--blocks=N]",
+                      "Compares the SNR and cost of the wavetable interpolation kernels.",
+                      {},
+                      InterpolationBenchmark::run });
+
+    app.addCommand ({ "--table-synthesis",
+                      "--table-synthesis [--harmonics=N] [--table-size=N] [--budget-kb=N] [--repeats=N]",
+                      "Compares building wavetables with std::sin, with an inverse FFT and from the cache.",
+                      {},
+                      TableSynthesisBenchmark::run });
+
+    app.addCommand ({ "--unison",
+                      "--unison [--notes=N] [--block-size=N] [--blocks=N]",
+                      "Compares unison stacks as separate oscillator objects and as bank lanes.",
+                      {},
+                      UnisonBenchmark::run });
+
+    app.addCommand ({ "--block-sine",
+                      "--block-sine [--oscillators=N] [--block-size=N] [--blocks=N]",
+                      "Compares the per-sample std::sin loop with the block sine generator.",
+                      {},
+                      BlockSineBenchmark::run });
+
+    app.addCommand ({ "--voice-allocation",
+                      "--voice-allocation [--voices=N] [--chord=N] [--block-size=N] [--blocks=N]",
+                      "Compares finding and stealing voices for dense chords in juce::Synthesiser and the voice allocator.",
+                      {},
+                      VoiceAllocationBenchmark::run });
+
+    app.addCommand ({ "--convolution",
+                      "--convolution [--block-size=N] [--blocks=N] [--max-partition=N] [--background-partition=N]",
+                      "Compares juce::dsp::Convolution with the partitioned convolver for impulse responses from 0.1 s to 10 s.",
+                      {},
+                      ConvolutionBenchmark::run });
+
+    app.addCommand ({ "--distortion",
+                      "--distortion [--channels=N] [--block-size=N] [--blocks=N]",
+                      "Compares the distortion's tanh curve plain, as double exp/log1p ADAA and as the vectorised AntialiasedTanh.",
+                      {},
+                      DistortionBenchmark::run });
+
+    return app.findAndRunCommand (argc, argv);
+}
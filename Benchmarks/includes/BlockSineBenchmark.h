@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <juce_core/juce_core.h>
+#include "BlockSineGenerator.h"
+#include "CommandLineOptions.h"
+
+//==============================================================================
+/**
+    Generates the same sines with the per-sample std::sin loop that
+    SineOscillator and SineWaveVoice used, and with BlockSineGenerator, and
+    prints the cost per sample of each along with the largest difference
+    between them.
+
+    Options: --oscillators=N (64), --block-size=N (256), --blocks=N (500)
+*/
+struct BlockSineBenchmark
+{
+    static constexpr double sampleRate = 48000.0;
+
+    static void run (const juce::ArgumentList& args)
+    {
+        auto numOscillators = CommandLineOptions::getInt (args, "--oscillators", 64);
+        auto blockSize      = CommandLineOptions::getInt (args, "--block-size", 256);
+        auto numBlocks      = CommandLineOptions::getInt (args, "--blocks", 500);
+
+        juce::Random random (1);
+        std::vector<double> angles ((size_t) numOscillators), angleDeltas ((size_t) numOscillators);
+        std::vector<BlockSineGenerator> generators ((size_t) numOscillators);
+
+        for (auto i = 0; i < numOscillators; ++i)
+        {
+            auto frequency = 440.0 * std::pow (2.0, (random.nextDouble() * 60.0 - 33.0) / 12.0);
+            angleDeltas[(size_t) i] = frequency / sampleRate * juce::MathConstants<double>::twoPi;
+            generators[(size_t) i].setFrequency (frequency, sampleRate);
+        }
+
+        std::vector<float> reference ((size_t) blockSize), block ((size_t) blockSize);
+        auto maxDifference = 0.0f;
+
+        auto sinSeconds = time (numBlocks, [&]
+        {
+            for (auto i = 0; i < numOscillators; ++i)
+            {
+                auto& angle = angles[(size_t) i];
+
+                for (auto sample = 0; sample < blockSize; ++sample)
+                {
+                    reference[(size_t) sample] = (float) std::sin (angle);
+                    angle += angleDeltas[(size_t) i];
+                }
+            }
+        });
+
+        auto blockSeconds = time (numBlocks, [&]
+        {
+            for (auto& generator : generators)
+                generator.generate (block.data(), blockSize);
+        });
+
+        // one more block from both, compared side by side
+        for (auto i = 0; i < numOscillators; ++i)
+        {
+            auto& generator = generators[(size_t) i];
+            generator.setPhase (0.0);
+
+            for (auto sample = 0; sample < blockSize; ++sample)
+                reference[(size_t) sample] = (float) std::sin (angleDeltas[(size_t) i] * sample);
+
+            generator.generate (block.data(), blockSize);
+
+            for (auto sample = 0; sample < blockSize; ++sample)
+                maxDifference = juce::jmax (maxDifference, std::abs (block[(size_t) sample] - reference[(size_t) sample]));
+        }
+
+        auto numSamples = (double) numBlocks * numOscillators * blockSize;
+
+        std::cout << numOscillators << " oscillators, " << blockSize << "-sample blocks, "
+                  << FloatLanes::width << " SIMD lanes" << std::endl
+                  << std::fixed << std::setprecision (2)
+                  << "std::sin:            " << sinSeconds * 1.0e9 / numSamples << " ns/sample" << std::endl
+                  << "BlockSineGenerator:  " << blockSeconds * 1.0e9 / numSamples << " ns/sample ("
+                  << sinSeconds / blockSeconds << "x)" << std::endl
+                  << std::scientific << std::setprecision (1)
+                  << "max difference:      " << maxDifference << " (bound " << BlockSineGenerator::maxError << ")" << std::endl;
+    }
+
+private:
+    template <typename Function>
+    static double time (int numBlocks, Function&& renderBlock)
+    {
+        for (auto block = 0; block < numBlocks / 10; ++block)
+            renderBlock();
+
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (auto block = 0; block < numBlocks; ++block)
+            renderBlock();
+
+        return juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+    }
+};
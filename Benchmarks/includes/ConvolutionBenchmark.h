@@ -0,0 +1,186 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <juce_dsp/juce_dsp.h>
+#include "PartitionedConvolver.h"
+#include "CommandLineOptions.h"
+
+//==============================================================================
+/**
+    Convolves noise with decaying-noise impulse responses from 0.1 s to 10 s
+    long. It uses juce::dsp::Convolution with uniform partitions, the same with
+    a non-uniform 64-sample head, and PartitionedConvolver, first on its own and
+    then with its long partitions on a ConvolutionTailThread. None of them adds
+    latency. For each it prints the mean and the worst time per block against
+    the block's real-time budget, since with long partitions the worst block
+    matters as much as the mean. With the tail thread only the audio thread's
+    share is timed, which should stay flat as the response grows. Those blocks
+    are paced in real time, since the tail thread is given a block's worth of
+    real time to finish each long partition, so that run takes a while.
+
+    Options: --block-size=N (256), --blocks=N (2000), --max-partition=N (4096),
+             --background-partition=N (1024)
+*/
+struct ConvolutionBenchmark
+{
+    static constexpr double sampleRate = 48000.0;
+
+    static void run (const juce::ArgumentList& args)
+    {
+        auto blockSize    = CommandLineOptions::getInt (args, "--block-size", 256);
+        auto numBlocks    = CommandLineOptions::getInt (args, "--blocks", 2000);
+        ConvolutionPartitioning partitioning;
+        partitioning.maxPartitionSize = juce::jlimit (partitioning.headSize, PartitionedImpulseResponse::largestPartitionSize,
+                                                      juce::nextPowerOfTwo (CommandLineOptions::getInt (args, "--max-partition", 4096)));
+
+        auto backgroundPartitioning = partitioning;
+        backgroundPartitioning.backgroundPartitionSize = juce::jmax (partitioning.headSize * 2,
+                                                                     juce::nextPowerOfTwo (CommandLineOptions::getInt (args, "--background-partition", 1024)));
+
+        std::cout << blockSize << "-sample blocks at " << sampleRate << " Hz, budget "
+                  << blockSize / sampleRate * 1.0e6 << " us, times in us per block (mean / worst)" << std::endl
+                  << std::fixed << std::setprecision (1)
+                  << "IR length   uniform              non-uniform          partitioned          tail thread" << std::endl;
+
+        juce::AudioBuffer<float> input (1, blockSize);
+        juce::Random random (2);
+        ConvolutionTailThread tailThread;
+
+        for (auto i = 0; i < blockSize; ++i)
+            input.setSample (0, i, random.nextFloat() * 2.0f - 1.0f);
+
+        for (auto irSeconds : { 0.1, 0.3, 1.0, 3.0, 10.0 })
+        {
+            auto impulseResponse = createImpulseResponse (irSeconds);
+
+            juce::dsp::Convolution uniform;
+            loadStock (uniform, impulseResponse, blockSize);
+            auto uniformTimes = time ([&] (float* block, int numSamples) { processStock (uniform, block, numSamples); },
+                                      input, numBlocks);
+
+            juce::dsp::Convolution nonUniform (juce::dsp::Convolution::NonUniform { partitioning.headSize });
+            loadStock (nonUniform, impulseResponse, blockSize);
+            auto nonUniformTimes = time ([&] (float* block, int numSamples) { processStock (nonUniform, block, numSamples); },
+                                         input, numBlocks);
+
+            PartitionedConvolver partitioned;
+            partitioned.setImpulseResponse (std::make_shared<const PartitionedImpulseResponse> (impulseResponse.getReadPointer (0),
+                                                                                                impulseResponse.getNumSamples(),
+                                                                                                partitioning));
+
+            auto partitionedTimes = time ([&] (float* block, int numSamples) { partitioned.process (block, block, numSamples); },
+                                          input, numBlocks);
+
+            PartitionedConvolver background;
+            background.setImpulseResponse (std::make_shared<const PartitionedImpulseResponse> (impulseResponse.getReadPointer (0),
+                                                                                               impulseResponse.getNumSamples(),
+                                                                                               backgroundPartitioning),
+                                           &tailThread);
+
+            auto backgroundTimes = time ([&] (float* block, int numSamples) { background.process (block, block, numSamples); },
+                                         input, numBlocks, true);
+
+            std::cout << std::setw (5) << irSeconds << " s     "
+                      << uniformTimes << "   " << nonUniformTimes << "   " << partitionedTimes << "   " << backgroundTimes
+                      << "  (" << background.getNumLateBlocks() << " late)" << std::endl;
+        }
+    }
+
+private:
+    //==============================================================================
+    struct BlockTimes
+    {
+        double mean = 0.0, worst = 0.0;
+
+        friend std::ostream& operator<< (std::ostream& stream, const BlockTimes& times)
+        {
+            return stream << std::setw (8) << times.mean << " / " << std::setw (8) << times.worst;
+        }
+    };
+
+    /** Noise that decays by 60 dB over its length, like a room. */
+    static juce::AudioBuffer<float> createImpulseResponse (double seconds)
+    {
+        auto numSamples = juce::roundToInt (seconds * sampleRate);
+        juce::AudioBuffer<float> buffer (1, numSamples);
+        juce::Random random (1);
+
+        for (auto i = 0; i < numSamples; ++i)
+            buffer.setSample (0, i, (random.nextFloat() * 2.0f - 1.0f) * std::pow (0.001f, (float) i / (float) numSamples));
+
+        return buffer;
+    }
+
+    /** Loads the response and waits for the background thread to install it. */
+    static void loadStock (juce::dsp::Convolution& convolution, const juce::AudioBuffer<float>& impulseResponse, int blockSize)
+    {
+        convolution.prepare ({ sampleRate, (juce::uint32) blockSize, 1 });
+        convolution.loadImpulseResponse (juce::AudioBuffer<float> (impulseResponse), sampleRate,
+                                         juce::dsp::Convolution::Stereo::no,
+                                         juce::dsp::Convolution::Trim::no,
+                                         juce::dsp::Convolution::Normalise::no);
+
+        juce::AudioBuffer<float> silence (1, blockSize);
+
+        for (auto tries = 0; convolution.getCurrentIRSize() != impulseResponse.getNumSamples() && tries < 2000; ++tries)
+        {
+            silence.clear();
+            processStock (convolution, silence.getWritePointer (0), blockSize);
+            juce::Thread::sleep (5);
+        }
+    }
+
+    static void processStock (juce::dsp::Convolution& convolution, float* samples, int numSamples)
+    {
+        float* channels[] = { samples };
+        juce::dsp::AudioBlock<float> block (channels, 1, (size_t) numSamples);
+        convolution.process (juce::dsp::ProcessContextReplacing<float> (block));
+    }
+
+    template <typename Function>
+    static BlockTimes time (Function&& process, const juce::AudioBuffer<float>& input, int numBlocks, bool inRealTime = false)
+    {
+        auto blockSize = input.getNumSamples();
+        juce::AudioBuffer<float> buffer (1, blockSize);
+
+        auto blockDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration> (std::chrono::duration<double> (blockSize / sampleRate));
+        auto nextCallback = std::chrono::steady_clock::now();
+
+        auto processBlock = [&]
+        {
+            if (inRealTime)
+            {
+                std::this_thread::sleep_until (nextCallback);
+                nextCallback += blockDuration;
+            }
+
+            buffer.copyFrom (0, 0, input, 0, 0, blockSize);
+
+            auto start = juce::Time::getHighResolutionTicks();
+            process (buffer.getWritePointer (0), blockSize);
+            return juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        };
+
+        // a second of audio first, so every stage has run and the stock
+        // convolution has finished fading in the new response
+        for (auto block = 0; block < juce::roundToInt (sampleRate) / blockSize; ++block)
+            processBlock();
+
+        BlockTimes times;
+
+        for (auto block = 0; block < numBlocks; ++block)
+        {
+            auto seconds = processBlock();
+            times.mean += seconds;
+            times.worst = juce::jmax (times.worst, seconds);
+        }
+
+        times.mean *= 1.0e6 / numBlocks;
+        times.worst *= 1.0e6;
+        return times;
+    }
+};
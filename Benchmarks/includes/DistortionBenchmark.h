@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <juce_core/juce_core.h>
+#include "AntialiasedTanh.h"
+#include "CommandLineOptions.h"
+
+//==============================================================================
+/**
+    Runs the Distortion's curve over a guitar-like signal after its 30 dB of
+    drive, at 4x oversampling: as plain std::tanh, which the WaveShaper ran
+    before the curve was antialiased; as the ADAA that took log cosh in
+    double with exp and log1p one sample at a time; and as AntialiasedTanh.
+    Prints the cost of each per sample at the base rate, and the largest
+    difference between the two ADAA versions.
+
+    Options: --channels=N (2), --block-size=N (512, at the base rate), --blocks=N (2000)
+*/
+struct DistortionBenchmark
+{
+    static constexpr int oversamplingFactor = 4;
+
+    static void run (const juce::ArgumentList& args)
+    {
+        auto numChannels = CommandLineOptions::getInt (args, "--channels", 2);
+        auto blockSize   = CommandLineOptions::getInt (args, "--block-size", 512);
+        auto numBlocks   = CommandLineOptions::getInt (args, "--blocks", 2000);
+
+        auto numOversampled = blockSize * oversamplingFactor;
+        auto drive = std::pow (10.0f, 30.0f / 20.0f);   // the Distortion's pre-gain
+
+        // a decaying pluck with some noise on it, so the steps vary in size
+        juce::Random random (1);
+        std::vector<float> input ((size_t) numOversampled);
+
+        for (auto i = 0; i < numOversampled; ++i)
+        {
+            auto envelope = std::exp (-3.0f * (float) i / (float) numOversampled);
+            auto angle = juce::MathConstants<float>::twoPi * 110.0f * (float) i / (48000.0f * oversamplingFactor);
+            input[(size_t) i] = drive * envelope * (0.5f * std::sin (angle) + 0.1f * std::sin (3.0f * angle)
+                                                    + 0.01f * (random.nextFloat() - 0.5f));
+        }
+
+        std::vector<std::vector<float>> blocks ((size_t) numChannels, input);
+        std::vector<ExpLogTanh> oldShapers ((size_t) numChannels);
+        std::vector<AntialiasedTanh<float>> shapers ((size_t) numChannels);
+
+        auto tanhSeconds = time (numBlocks, [&]
+        {
+            for (auto& block : blocks)
+                for (auto& sample : block)
+                    sample = std::tanh (sample);
+        }, blocks, input);
+
+        auto oldSeconds = time (numBlocks, [&]
+        {
+            for (size_t channel = 0; channel < blocks.size(); ++channel)
+                for (auto& sample : blocks[channel])
+                    sample = oldShapers[channel].processSample (sample);
+        }, blocks, input);
+
+        auto newSeconds = time (numBlocks, [&]
+        {
+            for (size_t channel = 0; channel < blocks.size(); ++channel)
+                shapers[channel].process (blocks[channel].data(), numOversampled);
+        }, blocks, input);
+
+        // one more block from both ADAA versions, compared side by side
+        ExpLogTanh oldShaper;
+        AntialiasedTanh<float> shaper;
+        auto block = input;
+        shaper.process (block.data(), numOversampled);
+        auto maxDifference = 0.0;
+
+        for (auto i = 0; i < numOversampled; ++i)
+            maxDifference = juce::jmax (maxDifference, std::abs ((double) block[(size_t) i] - oldShaper.processSample (input[(size_t) i])));
+
+        auto numSamples = (double) numBlocks * numChannels * blockSize;
+
+        std::cout << numChannels << " channels, " << blockSize << "-sample blocks at " << oversamplingFactor << "x, "
+                  << FloatLanes::width << " SIMD lanes" << std::endl
+                  << std::fixed << std::setprecision (2)
+                  << "std::tanh, no ADAA:        " << tanhSeconds * 1.0e9 / numSamples << " ns/sample" << std::endl
+                  << "ADAA, double exp/log1p:    " << oldSeconds * 1.0e9 / numSamples << " ns/sample" << std::endl
+                  << "AntialiasedTanh:           " << newSeconds * 1.0e9 / numSamples << " ns/sample ("
+                  << oldSeconds / newSeconds << "x the old ADAA, "
+                  << tanhSeconds / newSeconds << "x std::tanh)" << std::endl
+                  << std::scientific << std::setprecision (1)
+                  << "max difference from the old ADAA: " << maxDifference << std::endl;
+    }
+
+private:
+    /** The ADAA that Distortion used first: log cosh in double, one sample at a time. */
+    struct ExpLogTanh
+    {
+        float processSample (float input) noexcept
+        {
+            auto x = (double) input;
+            auto fx = std::abs (x) + std::log1p (std::exp (-2.0 * std::abs (x)));
+            auto dx = x - previousInput;
+
+            auto y = std::abs (dx) > 1.0e-5 ? (fx - previousAntiderivative) / dx
+                                            : std::tanh (0.5 * (x + previousInput));
+
+            previousInput = x;
+            previousAntiderivative = fx;
+            return (float) y;
+        }
+
+        double previousInput = 0.0, previousAntiderivative = std::log (2.0);
+    };
+
+    template <typename Function>
+    static double time (int numBlocks, Function&& shapeBlocks, std::vector<std::vector<float>>& blocks, const std::vector<float>& input)
+    {
+        auto seconds = 0.0;
+
+        for (auto block = -numBlocks / 10; block < numBlocks; ++block)
+        {
+            for (auto& channel : blocks)
+                std::copy (input.begin(), input.end(), channel.begin());
+
+            auto start = juce::Time::getHighResolutionTicks();
+            shapeBlocks();
+
+            if (block >= 0)
+                seconds += juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        }
+
+        return seconds;
+    }
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <iomanip>
+#include <iostream>
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "MipmappedWavetable.h"
+#include "WavetableInterpolation.h"
+#include "WavetableOscillatorBank.h"
+#include "CommandLineOptions.h"
+
+#if defined (_MSC_VER) && defined (_M_X64)
+ #include <intrin.h>
+#elif defined (__SSE2__)
+ #include <x86intrin.h>
+#endif
+
+//==============================================================================
+/**
+    Compares the wavetable interpolation kernels on a pure sine table of 128,
+    2048 and 8192 samples.
+
+    The SNR is measured against the exact sine at the same phases, over a spread
+    of frequencies, with the phase kept in double precision so that only the
+    interpolation error is counted. The speed is that of a full oscillator bank,
+    in nanoseconds (and, on x86, TSC cycles) per oscillator sample.
+
+    Options: --oscillators=N (1024), --block-size=N (256), --blocks=N (200)
+*/
+struct InterpolationBenchmark
+{
+    static constexpr double sampleRate = 48000.0;
+
+    static void run (const juce::ArgumentList& args)
+    {
+        auto numOscillators = CommandLineOptions::getInt (args, "--oscillators", 1024);
+        auto blockSize      = CommandLineOptions::getInt (args, "--block-size", 256);
+        auto numBlocks      = CommandLineOptions::getInt (args, "--blocks", 200);
+
+        std::cout << numOscillators << " oscillators, " << FloatLanes::width << " SIMD lanes" << std::endl
+                  << "kernel      table   SNR dB   ns/sample   cycles/sample" << std::endl;
+
+        for (auto tableSize : { 128, 2048, 8192 })
+        {
+            auto source = createSineTable (tableSize);
+
+            MipmappedWavetable table;
+            table.buildWithBaseSize (source, tableSize, 1);
+
+            Settings settings { table, numOscillators, blockSize, numBlocks };
+            measure<LinearInterpolation>       ("linear", settings);
+            measure<HermiteInterpolation>      ("hermite", settings);
+            measure<LagrangeInterpolation>     ("lagrange", settings);
+            measure<WindowedSincInterpolation> ("sinc8", settings);
+        }
+    }
+
+private:
+    //==============================================================================
+    struct Settings
+    {
+        const MipmappedWavetable& table;
+        int numOscillators, blockSize, numBlocks;
+    };
+
+    template <typename InterpolatorType>
+    static void measure (const char* name, const Settings& settings)
+    {
+        auto& level = settings.table.getLevels().getReference (0);
+
+        std::cout << std::left << std::setw (10) << name << std::right
+                  << std::setw (7)  << level.size
+                  << std::setw (9)  << std::fixed << std::setprecision (1) << measureSnr<InterpolatorType> (settings.table)
+                  << std::setprecision (2);
+
+        BasicWavetableOscillatorBank<InterpolatorType> bank;
+        bank.prepare (settings.numOscillators, settings.blockSize);
+        bank.setWavetable (settings.table);
+
+        juce::Random random (1);
+
+        for (auto i = 0; i < settings.numOscillators; ++i)
+            bank.addOscillator (50.0f + random.nextFloat() * 2000.0f, (float) sampleRate, 1.0f / (float) settings.numOscillators);
+
+        juce::HeapBlock<float> left ((size_t) settings.blockSize, true), right ((size_t) settings.blockSize, true);
+        bank.renderNextBlock (left.get(), right.get(), settings.blockSize);
+
+        auto startTicks = juce::Time::getHighResolutionTicks();
+        auto startCycles = readCycleCounter();
+
+        for (auto block = 0; block < settings.numBlocks; ++block)
+            bank.renderNextBlock (left.get(), right.get(), settings.blockSize);
+
+        auto cycles = (double) (readCycleCounter() - startCycles);
+        auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+        auto numOscillatorSamples = (double) settings.numOscillators * settings.blockSize * settings.numBlocks;
+
+        std::cout << std::setw (12) << seconds * 1.0e9 / numOscillatorSamples;
+
+        if (cycles > 0.0)
+            std::cout << std::setw (16) << cycles / numOscillatorSamples;
+        else
+            std::cout << std::setw (16) << "n/a";
+
+        std::cout << std::endl;
+    }
+
+    template <typename InterpolatorType>
+    static double measureSnr (const MipmappedWavetable& table)
+    {
+        auto& level = table.getLevels().getReference (0);
+        auto* samples = table.getData() + level.offset;
+        auto size = (double) level.size;
+
+        auto signalPower = 0.0, noisePower = 0.0;
+
+        for (auto frequency : { 27.5, 110.0, 440.0, 1760.0, 7040.0 })
+        {
+            auto delta = frequency * size / sampleRate;
+
+            for (auto i = 0; i < 48000; ++i)
+            {
+                auto phase = std::fmod (delta * i, size);
+                auto index = (int) phase;
+                auto frac = (float) (phase - index);
+
+                auto expected = std::sin (juce::MathConstants<double>::twoPi * phase / size);
+                auto actual = InterpolatorType::template interpolate<ScalarLanes> (samples, index, frac);
+
+                signalPower += expected * expected;
+                noisePower += (actual - expected) * (actual - expected);
+            }
+        }
+
+        return 10.0 * std::log10 (signalPower / juce::jmax (noisePower, 1.0e-30));
+    }
+
+    static juce::AudioSampleBuffer createSineTable (int tableSize)
+    {
+        juce::AudioSampleBuffer sine (1, tableSize + 1);
+
+        for (auto i = 0; i <= tableSize; ++i)
+            sine.setSample (0, i, (float) std::sin (juce::MathConstants<double>::twoPi * i / tableSize));
+
+        return sine;
+    }
+
+    static juce::uint64 readCycleCounter() noexcept
+    {
+       #if defined (__SSE2__) || defined (_M_X64)
+        return (juce::uint64) __rdtsc();
+       #else
+        return 0;
+       #endif
+    }
+};
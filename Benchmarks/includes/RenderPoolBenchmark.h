@@ -0,0 +1,124 @@
+#pragma once
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "CommandLineOptions.h"
+#include "MipmappedWavetable.h"
+#include "WavetableOscillatorBank.h"
+#include "WavetableRenderPool.h"
+
+//==============================================================================
+/**
+    Renders the same WavetableOscillatorBank on its own and then through a
+    WavetableRenderPool with 1 to N participating threads, and prints the time
+    per block, the speed-up over the bank rendering alone on one thread and
+    how many times faster than real time it runs.
+
+    Options: --oscillators=N (4096), --block-size=N (256), --blocks=N (2000),
+             --max-threads=N (number of logical CPUs)
+*/
+struct RenderPoolBenchmark
+{
+    static constexpr double sampleRate = 48000.0;
+
+    static void run (const juce::ArgumentList& args)
+    {
+        auto numOscillators = CommandLineOptions::getInt (args, "--oscillators", 4096);
+        auto blockSize      = CommandLineOptions::getInt (args, "--block-size", 256);
+        auto numBlocks      = CommandLineOptions::getInt (args, "--blocks", 2000);
+        auto maxThreads     = CommandLineOptions::getInt (args, "--max-threads", juce::SystemStats::getNumCpus());
+
+        auto source = createHarmonicTable (128);
+        MipmappedWavetable mipmaps;
+        mipmaps.build (source, 32 * 1024);
+
+        WavetableOscillatorBank bank;
+        bank.prepare (numOscillators, blockSize);
+        bank.setWavetable (mipmaps);
+
+        juce::Random random (1);
+
+        for (auto i = 0; i < numOscillators; ++i)
+        {
+            auto midiNote = random.nextDouble() * 36.0 + 48.0;
+            auto frequency = 440.0 * std::pow (2.0, (midiNote - 69.0) / 12.0);
+            auto pan = random.nextFloat() * 2.0f - 1.0f;
+            bank.addOscillator ((float) frequency, (float) sampleRate, 0.25f / (float) numOscillators, pan);
+        }
+
+        juce::HeapBlock<float> left ((size_t) blockSize), right ((size_t) blockSize);
+
+        auto timeBlocks = [&] (auto&& renderBlock)
+        {
+            auto renderBlocks = [&] (int count)
+            {
+                for (auto block = 0; block < count; ++block)
+                {
+                    juce::FloatVectorOperations::clear (left.get(), blockSize);
+                    juce::FloatVectorOperations::clear (right.get(), blockSize);
+                    renderBlock();
+                }
+            };
+
+            renderBlocks (numBlocks / 10);
+
+            auto start = juce::Time::getHighResolutionTicks();
+            renderBlocks (numBlocks);
+            return juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        };
+
+        auto audioSeconds = numBlocks * blockSize / sampleRate;
+
+        auto printRow = [&] (const std::string& label, double seconds, double baselineSeconds)
+        {
+            std::cout << std::setw (7)  << label
+                      << std::setw (11) << std::fixed << std::setprecision (2) << seconds * 1.0e6 / numBlocks
+                      << std::setw (11) << baselineSeconds / seconds
+                      << std::setw (13) << audioSeconds / seconds << std::endl;
+        };
+
+        std::cout << numOscillators << " oscillators, " << blockSize << "-sample blocks, "
+                  << FloatLanes::width << " SIMD lanes, " << juce::SystemStats::getNumCpus() << " logical CPUs" << std::endl
+                  << "threads   us/block   speed-up   x realtime" << std::endl;
+
+        // the bank on its own is the baseline, so the pool's overhead counts against it
+        auto bankSeconds = timeBlocks ([&] { bank.renderNextBlock (left.get(), right.get(), blockSize); });
+        printRow ("bank", bankSeconds, bankSeconds);
+
+        for (auto numThreads = 1; numThreads <= maxThreads; ++numThreads)
+        {
+            WavetableRenderPool pool (numThreads - 1);
+            pool.prepare (bank, blockSize);
+
+            auto seconds = timeBlocks ([&] { pool.render (bank, left.get(), right.get(), blockSize); });
+            printRow (std::to_string (numThreads), seconds, bankSeconds);
+        }
+    }
+
+    //==============================================================================
+    /** A table with the harmonic mix that the WaveTable app's createWavetable() uses. */
+    static juce::AudioSampleBuffer createHarmonicTable (int tableSize)
+    {
+        juce::AudioSampleBuffer table (1, tableSize + 1);
+        table.clear();
+
+        auto* samples = table.getWritePointer (0);
+
+        int harmonics[] = { 1, 3, 5, 6, 7, 9, 13, 15 };
+        float harmonicWeights[] = { 0.5f, 0.1f, 0.05f, 0.125f, 0.09f, 0.005f, 0.002f, 0.001f };
+
+        for (auto harmonic = 0; harmonic < juce::numElementsInArray (harmonics); ++harmonic)
+        {
+            auto angleDelta = juce::MathConstants<double>::twoPi / (double) tableSize * harmonics[harmonic];
+
+            for (auto i = 0; i < tableSize; ++i)
+                samples[i] += (float) std::sin (angleDelta * i) * harmonicWeights[harmonic];
+        }
+
+        samples[tableSize] = samples[0];
+        return table;
+    }
+};
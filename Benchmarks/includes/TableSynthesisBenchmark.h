@@ -0,0 +1,102 @@
+#pragma once
+
+#include <iomanip>
+#include <iostream>
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "HarmonicSpectrum.h"
+#include "MipmappedWavetable.h"
+#include "WavetableCache.h"
+#include "CommandLineOptions.h"
+
+//==============================================================================
+/**
+    Times the different ways of building a wavetable from a list of harmonics:
+
+    - the std::sin loop that createWavetable() used, followed by
+      MipmappedWavetable::build();
+    - one inverse FFT for the single cycle, followed by build();
+    - MipmappedWavetable::buildFromSpectrum(), which skips the single cycle;
+    - a WavetableCache hit.
+
+    Options: --harmonics=N (64), --table-size=N (2048), --budget-kb=N (1024),
+             --repeats=N (20)
+*/
+struct TableSynthesisBenchmark
+{
+    static void run (const juce::ArgumentList& args)
+    {
+        auto numHarmonics = CommandLineOptions::getInt (args, "--harmonics", 64);
+        auto tableSize    = juce::nextPowerOfTwo (CommandLineOptions::getInt (args, "--table-size", 2048));
+        auto budget       = (size_t) CommandLineOptions::getInt (args, "--budget-kb", 1024) * 1024;
+        auto repeats      = CommandLineOptions::getInt (args, "--repeats", 20);
+
+        HarmonicSpectrum spectrum;
+
+        for (auto harmonic = 1; harmonic <= numHarmonics; ++harmonic)
+            spectrum.add (harmonic, 0.5f / (float) harmonic);
+
+        std::cout << numHarmonics << " harmonics, " << tableSize << "-sample source, "
+                  << budget / 1024 << " kB of mipmaps" << std::endl
+                  << "method                 ms/table" << std::endl;
+
+        report ("sin loop + build", repeats, [&]
+        {
+            MipmappedWavetable mipmaps;
+            mipmaps.build (createWithSin (spectrum, tableSize), budget);
+        });
+
+        report ("inverse FFT + build", repeats, [&]
+        {
+            MipmappedWavetable mipmaps;
+            mipmaps.build (spectrum.createSingleCycle (tableSize), budget);
+        });
+
+        report ("buildFromSpectrum", repeats, [&]
+        {
+            MipmappedWavetable mipmaps;
+            mipmaps.buildFromSpectrum (spectrum, budget);
+        });
+
+        WavetableCache cache;
+        cache.getOrBuild (spectrum, budget);
+
+        report ("cache hit", repeats, [&] { cache.getOrBuild (spectrum, budget); });
+    }
+
+private:
+    //==============================================================================
+    template <typename Function>
+    static void report (const char* name, int repeats, Function&& buildTable)
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (auto i = 0; i < repeats; ++i)
+            buildTable();
+
+        auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+        std::cout << std::left << std::setw (20) << name << std::right
+                  << std::setw (12) << std::fixed << std::setprecision (3) << seconds * 1.0e3 / repeats << std::endl;
+    }
+
+    /** The old way: every harmonic evaluated with std::sin at every sample. */
+    static juce::AudioSampleBuffer createWithSin (const HarmonicSpectrum& spectrum, int tableSize)
+    {
+        juce::AudioSampleBuffer table (1, tableSize + 1);
+        table.clear();
+
+        auto* samples = table.getWritePointer (0);
+
+        for (auto& harmonic : spectrum.getHarmonics())
+        {
+            auto angleDelta = juce::MathConstants<double>::twoPi / (double) tableSize * harmonic.number;
+
+            for (auto i = 0; i < tableSize; ++i)
+                samples[i] += (float) std::sin (angleDelta * i + harmonic.phase) * harmonic.amplitude;
+        }
+
+        samples[tableSize] = samples[0];
+        return table;
+    }
+};
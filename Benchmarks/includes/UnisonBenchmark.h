@@ -0,0 +1,117 @@
+#pragma once
+
+#include <iomanip>
+#include <iostream>
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "CommandLineOptions.h"
+#include "WavetableOscillator.h"
+#include "WavetableOscillatorBank.h"
+#include "WavetableUnison.h"
+#include "RenderPoolBenchmark.h"
+
+//==============================================================================
+/**
+    Plays the same unison stacks twice: as one WavetableOscillator object per
+    voice, mixed into both channels sample by sample as the tutorial used to,
+    and as adjacent lanes of a WavetableOscillatorBank. Prints the time per
+    block of each and the speed-up for stacks of 1, 7 and 16 voices.
+
+    Options: --notes=N (16), --block-size=N (256), --blocks=N (500)
+*/
+struct UnisonBenchmark
+{
+    static constexpr double sampleRate = 48000.0;
+
+    static void run (const juce::ArgumentList& args)
+    {
+        auto numNotes  = CommandLineOptions::getInt (args, "--notes", 16);
+        auto blockSize = CommandLineOptions::getInt (args, "--block-size", 256);
+        auto numBlocks = CommandLineOptions::getInt (args, "--blocks", 500);
+
+        auto table = RenderPoolBenchmark::createHarmonicTable (2048);
+
+        std::cout << numNotes << " notes, " << blockSize << "-sample blocks, "
+                  << FloatLanes::width << " SIMD lanes" << std::endl
+                  << "voices   objects us/block   bank us/block   speed-up" << std::endl;
+
+        for (auto numVoices : { 1, 7, 16 })
+        {
+            UnisonSettings unison;
+            unison.numVoices = numVoices;
+            unison.detuneCents = 25.0f;
+            unison.stereoSpread = 1.0f;
+
+            WavetableOscillatorBank bank;
+            bank.prepare (numNotes * numVoices, blockSize);
+            bank.setWavetable (table);
+
+            juce::Random random (1);
+
+            for (auto note = 0; note < numNotes; ++note)
+            {
+                auto frequency = 440.0 * std::pow (2.0, (random.nextDouble() * 36.0 - 21.0) / 12.0);
+                WavetableUnison::addStack (bank, (float) frequency, (float) sampleRate, 0.25f / (float) numNotes, 0.0f, unison, random);
+            }
+
+            // the same voices as separate objects
+            juce::OwnedArray<WavetableOscillator> oscillators;
+            juce::Array<float> leftGains, rightGains;
+
+            for (auto i = 0; i < bank.size(); ++i)
+            {
+                oscillators.add (new WavetableOscillator (table))->setFrequency (bank.getFrequency (i), (float) sampleRate);
+                leftGains .add (bank.getGain (i) * juce::jmin (1.0f, 1.0f - bank.getPan (i)));
+                rightGains.add (bank.getGain (i) * juce::jmin (1.0f, 1.0f + bank.getPan (i)));
+            }
+
+            juce::AudioBuffer<float> output (2, blockSize);
+
+            auto objectSeconds = time (numBlocks, [&]
+            {
+                output.clear();
+                auto* left  = output.getWritePointer (0);
+                auto* right = output.getWritePointer (1);
+
+                for (auto i = 0; i < oscillators.size(); ++i)
+                {
+                    auto* oscillator = oscillators.getUnchecked (i);
+                    auto leftGain = leftGains[i], rightGain = rightGains[i];
+
+                    for (auto sample = 0; sample < blockSize; ++sample)
+                    {
+                        auto levelSample = oscillator->getNextSample();
+                        left[sample]  += levelSample * leftGain;
+                        right[sample] += levelSample * rightGain;
+                    }
+                }
+            });
+
+            auto bankSeconds = time (numBlocks, [&]
+            {
+                output.clear();
+                bank.renderNextBlock (output.getWritePointer (0), output.getWritePointer (1), blockSize);
+            });
+
+            std::cout << std::setw (6) << numVoices
+                      << std::setw (21) << std::fixed << std::setprecision (2) << objectSeconds * 1.0e6 / numBlocks
+                      << std::setw (16) << bankSeconds * 1.0e6 / numBlocks
+                      << std::setw (11) << objectSeconds / bankSeconds << std::endl;
+        }
+    }
+
+private:
+    template <typename Function>
+    static double time (int numBlocks, Function&& renderBlock)
+    {
+        for (auto block = 0; block < numBlocks / 10; ++block)
+            renderBlock();
+
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (auto block = 0; block < numBlocks; ++block)
+            renderBlock();
+
+        return juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+    }
+};
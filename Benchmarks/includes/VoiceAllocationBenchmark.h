@@ -0,0 +1,185 @@
+#pragma once
+
+#include <iomanip>
+#include <iostream>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "ActiveVoiceSynthesiser.h"
+#include "CommandLineOptions.h"
+
+//==============================================================================
+/**
+    Plays dense chords into a stock juce::Synthesiser and into an
+    ActiveVoiceSynthesiser with each stealing policy, and prints the cost of a
+    block for each. The voices do next to no work, so what is measured is
+    finding voices to start, stop and steal, plus visiting the voices that are
+    rendered.
+
+    Every block starts a chord on each of four channels, a whole tone above the
+    last one, and releases the chords started four blocks before. The notes
+    keep a short tail, so once the voices run out every chord has to steal.
+
+    Options: --voices=N (256), --chord=N (16), --block-size=N (128), --blocks=N (4000)
+*/
+struct VoiceAllocationBenchmark
+{
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int numChannels = 4;
+    static constexpr int blocksHeld = 4;
+
+    static void run (const juce::ArgumentList& args)
+    {
+        auto numVoices = CommandLineOptions::getInt (args, "--voices", 256);
+        auto chordSize = CommandLineOptions::getInt (args, "--chord", 16);
+        auto blockSize = CommandLineOptions::getInt (args, "--block-size", 128);
+        auto numBlocks = CommandLineOptions::getInt (args, "--blocks", 4000);
+
+        auto blocks = createChords (numBlocks, chordSize, blockSize);
+        auto numEvents = 2.0 * numChannels * chordSize;
+
+        std::cout << numVoices << " voices, " << numChannels << " chords of " << chordSize
+                  << " notes on and off per " << blockSize << "-sample block" << std::endl
+                  << std::fixed << std::setprecision (2);
+
+        juce::Synthesiser stock;
+        auto stockSeconds = time (stock, numVoices, blocks, blockSize);
+
+        std::cout << "juce::Synthesiser:        " << stockSeconds * 1.0e6 / numBlocks << " us/block, "
+                  << stockSeconds * 1.0e9 / numBlocks / numEvents << " ns/event" << std::endl;
+
+        const std::pair<VoiceAllocator::StealingPolicy, const char*> policies[] = {
+            { VoiceAllocator::StealingPolicy::oldest,   "oldest" },
+            { VoiceAllocator::StealingPolicy::quietest, "quietest" },
+            { VoiceAllocator::StealingPolicy::sameNote, "same note" }
+        };
+
+        for (auto& [policy, name] : policies)
+        {
+            ActiveVoiceSynthesiser synth;
+            synth.setStealingPolicy (policy);
+            synth.setPolyphony (numVoices * 3 / 4);
+
+            auto seconds = time (synth, numVoices, blocks, blockSize);
+
+            std::cout << "VoiceAllocator, " << std::left << std::setw (10) << name << std::right
+                      << seconds * 1.0e6 / numBlocks << " us/block, "
+                      << seconds * 1.0e9 / numBlocks / numEvents << " ns/event ("
+                      << stockSeconds / seconds << "x)" << std::endl;
+        }
+    }
+
+private:
+    //==============================================================================
+    struct AnySound   : public juce::SynthesiserSound
+    {
+        bool appliesToNote (int) override       { return true; }
+        bool appliesToChannel (int) override    { return true; }
+    };
+
+    /** Holds its note, then tails off for a few blocks' worth of samples. */
+    struct TailVoice   : public juce::SynthesiserVoice,
+                         public LevelReportingVoice
+    {
+        bool canPlaySound (juce::SynthesiserSound*) override    { return true; }
+
+        void startNote (int, float velocity, juce::SynthesiserSound*, int) override
+        {
+            level = velocity;
+            samplesLeft = -1;
+        }
+
+        void stopNote (float, bool allowTailOff) override
+        {
+            if (allowTailOff && samplesLeft < 0)
+                samplesLeft = tailSamples;
+            else if (! allowTailOff)
+                clearCurrentNote();
+        }
+
+        void pitchWheelMoved (int) override         {}
+        void controllerMoved (int, int) override    {}
+
+        float getCurrentLevel() const noexcept override     { return level; }
+
+        void renderNextBlock (juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
+        {
+            render (outputBuffer, startSample, numSamples);
+        }
+
+        void renderNextBlock (juce::AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override
+        {
+            render (outputBuffer, startSample, numSamples);
+        }
+
+        template <typename FloatType>
+        void render (juce::AudioBuffer<FloatType>& outputBuffer, int startSample, int numSamples)
+        {
+            if (! isVoiceActive())
+                return;
+
+            outputBuffer.addSample (0, startSample, (FloatType) level);
+
+            if (samplesLeft >= 0)
+            {
+                samplesLeft -= numSamples;
+                level *= 0.5f;
+
+                if (samplesLeft <= 0)
+                    clearCurrentNote();
+            }
+        }
+
+        static constexpr int tailSamples = 512;
+        int samplesLeft = -1;
+        float level = 0.0f;
+    };
+
+    //==============================================================================
+    static std::vector<juce::MidiBuffer> createChords (int numBlocks, int chordSize, int blockSize)
+    {
+        std::vector<juce::MidiBuffer> blocks ((size_t) numBlocks);
+
+        auto chordRoot = [] (int block, int channel) { return (block * 2 + channel * 5) % 48 + 24; };
+
+        for (auto block = 0; block < numBlocks; ++block)
+        {
+            auto& midi = blocks[(size_t) block];
+
+            for (auto channel = 1; channel <= numChannels; ++channel)
+            {
+                auto position = (channel * blockSize) / (numChannels + 1);
+
+                if (block >= blocksHeld)
+                    for (auto i = 0; i < chordSize; ++i)
+                        midi.addEvent (juce::MidiMessage::noteOff (channel, chordRoot (block - blocksHeld, channel) + i * 3 % 56),
+                                       position);
+
+                for (auto i = 0; i < chordSize; ++i)
+                    midi.addEvent (juce::MidiMessage::noteOn (channel, chordRoot (block, channel) + i * 3 % 56, 0.2f + 0.05f * (float) (i % 16)),
+                                   position);
+            }
+        }
+
+        return blocks;
+    }
+
+    static double time (juce::Synthesiser& synth, int numVoices, const std::vector<juce::MidiBuffer>& blocks, int blockSize)
+    {
+        for (auto i = 0; i < numVoices; ++i)
+            synth.addVoice (new TailVoice());
+
+        synth.addSound (new AnySound());
+        synth.setCurrentPlaybackSampleRate (sampleRate);
+
+        juce::AudioBuffer<float> buffer (2, blockSize);
+
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (auto& midi : blocks)
+        {
+            buffer.clear();
+            synth.renderNextBlock (buffer, midi, 0, blockSize);
+        }
+
+        return juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+    }
+};
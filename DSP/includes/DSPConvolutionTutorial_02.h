@@ -50,6 +50,9 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_utils/juce_audio_utils.h>
 #include <juce_dsp/juce_dsp.h>
+#include "AntialiasedTanh.h"
+#include "ImpulseResponseCache.h"
+#include "PartitionedConvolver.h"
 
 //==============================================================================
 template <typename Type>
@@ -123,7 +126,7 @@ public:
     {
         auto&& outBlock = context.getOutputBlock();
         auto blockToUse = tempBlock.getSubBlock (0, outBlock.getNumSamples());
-        juce::dsp::ProcessContextReplacing<float> tempContext (blockToUse);
+        juce::dsp::ProcessContextReplacing<Type> tempContext (blockToUse);
         processorChain.process (tempContext);
 
         outBlock.copyFrom (context.getInputBlock()).add (blockToUse);
@@ -132,14 +135,14 @@ public:
     //==============================================================================
     void prepare (const juce::dsp::ProcessSpec& spec)
     {
-        tempBlock = juce::dsp::AudioBlock<float> (heapBlock, spec.numChannels, spec.maximumBlockSize);
+        tempBlock = juce::dsp::AudioBlock<Type> (heapBlock, spec.numChannels, spec.maximumBlockSize);
         processorChain.prepare (spec);
     }
 
 private:
     //==============================================================================
     juce::HeapBlock<char> heapBlock;
-    juce::dsp::AudioBlock<float> tempBlock;
+    juce::dsp::AudioBlock<Type> tempBlock;
 
     enum
     {
@@ -151,81 +154,157 @@ private:
 };
 
 //==============================================================================
+/**
+    Plays the guitar cabinet impulse response through a PartitionedConvolver
+    per channel, so the cabinet adds no latency. prepare() takes the response
+    from the process-wide ImpulseResponseCache, resampled to the processing
+    rate, normalised as juce::dsp::Convolution would and already partitioned,
+    so every CabSimulator at the same rate shares one copy of the spectra.
+
+    Partitions of backgroundPartitionSize samples and up are computed on a
+    ConvolutionTailThread shared by every CabSimulator, so a long response
+    costs the audio thread no more than a short one.
+*/
 template <typename Type>
 class CabSimulator
 {
 public:
     //==============================================================================
-    CabSimulator()
-    {
-        auto dir = juce::File::getCurrentWorkingDirectory();
+    CabSimulator() = default;
 
-        int numTries = 0;
+    //==============================================================================
+    void prepare (const juce::dsp::ProcessSpec& spec)
+    {
+        convolvers.clear();
 
-        while (! dir.getChildFile ("Resources").exists() && numTries++ < 15)
-            dir = dir.getParentDirectory();
+        auto responses = cache->getOrLoad (getImpulseResponseFile(), maxImpulseResponseSize,             // [6]
+                                           spec.sampleRate, partitioning);
 
-        auto& convolution = processorChain.template get<convolutionIndex>();    // [5]
+        if (responses.empty())
+            return;
 
-        convolution.loadImpulseResponse (dir.getChildFile ("Resources").getChildFile ("guitar_amp.wav"),
-                                         juce::dsp::Convolution::Stereo::yes,
-                                         juce::dsp::Convolution::Trim::no,
-                                         1024);                                 // [6]
+        // a mono response is shared by every channel
+        for (size_t channel = 0; channel < spec.numChannels; ++channel)
+        {
+            auto* convolver = convolvers.add (new PartitionedConvolver());
+            convolver->setImpulseResponse (responses[juce::jmin (channel, responses.size() - 1)], tailThread);
+            convolver->setNonRealtime (nonRealtime);
+        }
     }
 
-    //==============================================================================
-    void prepare (const juce::dsp::ProcessSpec& spec)
+    /** Offline, the convolvers wait for the tail thread instead of dropping late blocks. */
+    void setNonRealtime (bool isNonRealtime) noexcept
     {
-        processorChain.prepare (spec); // [4]
+        nonRealtime = isNonRealtime;
+
+        for (auto* convolver : convolvers)
+            convolver->setNonRealtime (isNonRealtime);
     }
 
     //==============================================================================
     template <typename ProcessContext>
     void process (const ProcessContext& context) noexcept
     {
-        processorChain.process (context); // [7]
+        auto&& inBlock  = context.getInputBlock();
+        auto&& outBlock = context.getOutputBlock();
+
+        if (context.isBypassed || convolvers.size() == 0)
+        {
+            if (context.usesSeparateInputAndOutputBlocks())
+                outBlock.copyFrom (inBlock);
+
+            return;
+        }
+
+        auto numChannels = juce::jmin (outBlock.getNumChannels(), (size_t) convolvers.size());
+
+        for (size_t channel = 0; channel < numChannels; ++channel)
+            convolvers.getUnchecked ((int) channel)->process (inBlock.getChannelPointer (channel),
+                                                              outBlock.getChannelPointer (channel),
+                                                              (int) outBlock.getNumSamples());
     }
 
     //==============================================================================
     void reset() noexcept
     {
-        processorChain.reset(); // [3]
+        for (auto* convolver : convolvers)
+            convolver->reset();
     }
 
 private:
     //==============================================================================
-    enum
+    static constexpr int maxImpulseResponseSize = 1024;
+    static constexpr int backgroundPartitionSize = 1024;
+    static constexpr ConvolutionPartitioning partitioning { 64, 4096, backgroundPartitionSize };
+
+    /** Looks for the Resources folder above the working directory, the first time only. */
+    static const juce::File& getImpulseResponseFile()
     {
-        convolutionIndex // [2]
-    };
+        static const juce::File file = []
+        {
+            auto dir = juce::File::getCurrentWorkingDirectory();
 
-    juce::dsp::ProcessorChain<juce::dsp::Convolution> processorChain;
+            int numTries = 0;
+
+            while (! dir.getChildFile ("Resources").exists() && numTries++ < 15)
+                dir = dir.getParentDirectory();
+
+            return dir.getChildFile ("Resources").getChildFile ("guitar_amp.wav");
+        }();
+
+        return file;
+    }
+
+    //==============================================================================
+    juce::SharedResourcePointer<ImpulseResponseCache> cache;
+
+    // declared before the convolvers, which have to be destroyed first
+    juce::SharedResourcePointer<ConvolutionTailThread> tailThread;
+    juce::OwnedArray<PartitionedConvolver> convolvers;
+    bool nonRealtime = false;
 };
 
 //==============================================================================
+/**
+    Drives the voices into a tanh curve after 30 dB of gain. The curve runs
+    oversampled, between the polyphase half-band stages of a
+    juce::dsp::Oversampling, and uses AntialiasedTanh rather than plain tanh,
+    so little of the drive's harmonics folds back into the audible band. The
+    antialiased curve lets a low factor do the work that plain tanh would
+    need a much higher one for.
+
+    getLatencyInSamples() is the delay of the filters and the curve, which
+    the processor reports to the host.
+*/
 template <typename Type>
 class Distortion
 {
 public:
+    using FilterType = typename juce::dsp::Oversampling<Type>::FilterType;
+
     //==============================================================================
     Distortion()
     {
-        auto& waveshaper = processorChain.template get<waveshaperIndex>(); // [5]
-        //waveshaper.functionToUse = [] (Type x) { return jlimit (Type (-0.1), Type (0.1), x); };
-
-        waveshaper.functionToUse = [] (Type x)
-                                   {
-                                       return std::tanh (x);
-                                   };
-
         auto& preGain = processorChain.template get<preGainIndex>();
         preGain.setGainDecibels (30.0f);
 
-        auto& postGain = processorChain.template get<postGainIndex>();
         //postGain.setGainDecibels (-20.0f);
         postGain.setGainDecibels (0.0f);
     }
 
+    //==============================================================================
+    /** Sets how many times the base rate the curve runs at, from 2 to 16, and
+        whether the half-band stages are low-latency polyphase IIRs or
+        linear-phase FIRs. Takes effect at the next prepare().
+    */
+    void setOversampling (int factor, FilterType type)
+    {
+        jassert (juce::isPowerOfTwo (factor) && factor >= 2 && factor <= 16);
+
+        oversamplingFactor = factor;
+        filterType = type;
+    }
+
     //==============================================================================
     void prepare (const juce::dsp::ProcessSpec& spec)
     {
@@ -233,6 +312,15 @@ public:
         filter.state = FilterCoefs::makeFirstOrderHighPass (spec.sampleRate, 1000.0f);  // [4]
 
         processorChain.prepare (spec);
+        postGain.prepare (spec);
+
+        oversampling = std::make_unique<juce::dsp::Oversampling<Type>> (spec.numChannels,
+                                                                         (size_t) juce::findHighestSetBit ((juce::uint32) oversamplingFactor),
+                                                                         filterType, true, true);
+        oversampling->initProcessing (spec.maximumBlockSize);
+
+        shapers.clear();
+        shapers.resize (spec.numChannels);
     }
 
     //==============================================================================
@@ -240,12 +328,43 @@ public:
     void process (const ProcessContext& context) noexcept
     {
         processorChain.process (context); // [7]
+
+        if (context.isBypassed)
+            return;
+
+        auto outBlock = context.getOutputBlock();
+        auto upsampled = oversampling->processSamplesUp (outBlock);
+
+        for (size_t channel = 0; channel < upsampled.getNumChannels(); ++channel)
+            shapers[channel].process (upsampled.getChannelPointer (channel), (int) upsampled.getNumSamples());
+
+        oversampling->processSamplesDown (outBlock);
+        postGain.process (juce::dsp::ProcessContextReplacing<Type> (outBlock));
     }
 
     //==============================================================================
     void reset() noexcept
     {
         processorChain.reset();     // [3]
+        postGain.reset();
+
+        if (oversampling != nullptr)
+            oversampling->reset();
+
+        for (auto& shaper : shapers)
+            shaper.reset();
+    }
+
+    /** In samples at the base rate: the half-band stages' delay, rounded up
+        to a whole sample, plus the half sample the curve adds at the
+        oversampled rate.
+    */
+    Type getLatencyInSamples() const noexcept
+    {
+        if (oversampling == nullptr)
+            return Type (0);
+
+        return oversampling->getLatencyInSamples() + Type (0.5) / (Type) oversamplingFactor;
     }
 
 private:
@@ -253,105 +372,91 @@ private:
     enum
     {
         filterIndex,        // [2]
-        preGainIndex,
-        waveshaperIndex,
-        postGainIndex
+        preGainIndex
     };
 
     using Filter = juce::dsp::IIR::Filter<Type>;
     using FilterCoefs = juce::dsp::IIR::Coefficients<Type>;
 
-    juce::dsp::ProcessorChain<juce::dsp::ProcessorDuplicator<Filter, FilterCoefs>,
-                              juce::dsp::Gain<Type>, juce::dsp::WaveShaper<Type>, juce::dsp::Gain<Type>> processorChain;
+    juce::dsp::ProcessorChain<juce::dsp::ProcessorDuplicator<Filter, FilterCoefs>, juce::dsp::Gain<Type>> processorChain;
+
+    int oversamplingFactor = 4;
+    FilterType filterType = FilterType::filterHalfBandPolyphaseIIR;
+    std::unique_ptr<juce::dsp::Oversampling<Type>> oversampling;
+    std::vector<AntialiasedTanh<Type>> shapers;
+
+    juce::dsp::Gain<Type> postGain;
 };
 
 //==============================================================================
-class Voice  : public juce::MPESynthesiserVoice
+/** The oscillators, filter and LFO of a Voice, running in one sample type. */
+template <typename Type>
+class VoiceChain
 {
 public:
-    Voice()
+    //==============================================================================
+    VoiceChain()
     {
-        lfo.initialise ([] (float x)
+        lfo.initialise ([] (Type x)
                         {
                             return std::sin (x);
                         }, 128);
-        lfo.setFrequency (3.0f);
+        lfo.setFrequency (Type (3));
 
-        auto waveform = CustomOscillator<float>::Waveform::saw;
-        processorChain.get<osc1Index>().setWaveform (waveform);
-        processorChain.get<osc2Index>().setWaveform (waveform);
+        auto waveform = CustomOscillator<Type>::Waveform::saw;
+        processorChain.template get<osc1Index>().setWaveform (waveform);
+        processorChain.template get<osc2Index>().setWaveform (waveform);
 
-        auto& masterGain = processorChain.get<masterGainIndex>();
-        masterGain.setGainLinear (0.7f);
+        auto& masterGain = processorChain.template get<masterGainIndex>();
+        masterGain.setGainLinear (Type (0.7));
 
-        auto& filter = processorChain.get<filterIndex>();
-        filter.setMode (juce::dsp::LadderFilter<float>::Mode::LPF24);
-        filter.setResonance (0.7f);
-        filter.setCutoffFrequencyHz (500.0f);
+        auto& filter = processorChain.template get<filterIndex>();
+        filter.setMode (juce::dsp::LadderFilter<Type>::Mode::LPF24);
+        filter.setResonance (Type (0.7));
+        filter.setCutoffFrequencyHz (Type (500));
     }
 
     //==============================================================================
     void prepare (const juce::dsp::ProcessSpec& spec)
     {
         lfo.prepare ({ spec.sampleRate / lfoDownsamplingRatio, spec.maximumBlockSize, 1 });
-        tempBlock = juce::dsp::AudioBlock<float> (heapBlock, spec.numChannels, spec.maximumBlockSize);
+        tempBlock = juce::dsp::AudioBlock<Type> (heapBlock, spec.numChannels, spec.maximumBlockSize);
         processorChain.prepare (spec);
     }
 
     //==============================================================================
-    void noteStarted() override
+    void setFrequency (Type freqHz, bool force = false)
     {
-        auto velocity = getCurrentlyPlayingNote().noteOnVelocity.asUnsignedFloat();
-        auto freqHz = (float) getCurrentlyPlayingNote().getFrequencyInHertz();
-
-        processorChain.get<osc1Index>().setFrequency (freqHz, true);
-        processorChain.get<osc1Index>().setLevel (velocity);
-
-        processorChain.get<osc2Index>().setFrequency (1.01f * freqHz, true);
-        processorChain.get<osc2Index>().setLevel (velocity);
+        processorChain.template get<osc1Index>().setFrequency (freqHz, force);
+        processorChain.template get<osc2Index>().setFrequency (Type (1.01) * freqHz, force);
     }
 
-    //==============================================================================
-    void notePitchbendChanged () override
-    {
-        auto freqHz = (float) getCurrentlyPlayingNote().getFrequencyInHertz();
-        processorChain.get<osc1Index>().setFrequency (freqHz);
-        processorChain.get<osc2Index>().setFrequency (1.01f * freqHz);
-    }
-
-    //==============================================================================
-    void noteStopped (bool) override
+    void setLevel (Type newValue)
     {
-        clearCurrentNote();
+        processorChain.template get<osc1Index>().setLevel (newValue);
+        processorChain.template get<osc2Index>().setLevel (newValue);
     }
 
     //==============================================================================
-    void notePressureChanged() override {}
-    void noteTimbreChanged() override   {}
-    void noteKeyStateChanged() override {}
-
-    //==============================================================================
-    void renderNextBlock (juce::AudioBuffer<double>&, int, int) override
-    {}
-    void renderNextBlock (juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
+    void renderNextBlock (juce::AudioBuffer<Type>& outputBuffer, int startSample, int numSamples)
     {
         for (int i = 0; i < numSamples; ++i)
         {
             if (--lfoProcessingIndex == 0)
             {
                 lfoProcessingIndex = lfoDownsamplingRatio;
-                auto lfoOut = lfo.processSample (0.0f);
-                auto cutoffHz = juce::jmap (lfoOut, -1.0f, 1.0f, 100.0f, 4e3f);
-                processorChain.get<filterIndex>().setCutoffFrequencyHz (cutoffHz);
+                auto lfoOut = lfo.processSample (Type (0));
+                auto cutoffHz = juce::jmap (lfoOut, Type (-1), Type (1), Type (100), Type (4e3));
+                processorChain.template get<filterIndex>().setCutoffFrequencyHz (cutoffHz);
             }
         }
 
         auto block = tempBlock.getSubBlock (0, (size_t) numSamples);
         block.clear();
-        juce::dsp::ProcessContextReplacing<float> context (block);
+        juce::dsp::ProcessContextReplacing<Type> context (block);
         processorChain.process (context);
 
-        juce::dsp::AudioBlock<float> (outputBuffer)
+        juce::dsp::AudioBlock<Type> (outputBuffer)
             .getSubBlock ((size_t) startSample, (size_t) numSamples)
             .add (tempBlock);
     }
@@ -359,7 +464,7 @@ public:
 private:
     //==============================================================================
     juce::HeapBlock<char> heapBlock;
-    juce::dsp::AudioBlock<float> tempBlock;
+    juce::dsp::AudioBlock<Type> tempBlock;
 
     enum
     {
@@ -369,12 +474,75 @@ private:
         masterGainIndex
     };
 
-    juce::dsp::ProcessorChain<CustomOscillator<float>, CustomOscillator<float>,
-                              juce::dsp::LadderFilter<float>, juce::dsp::Gain<float>> processorChain;
+    juce::dsp::ProcessorChain<CustomOscillator<Type>, CustomOscillator<Type>,
+                              juce::dsp::LadderFilter<Type>, juce::dsp::Gain<Type>> processorChain;
 
     static constexpr size_t lfoDownsamplingRatio = 128;
     size_t lfoProcessingIndex = lfoDownsamplingRatio;
-    juce::dsp::Oscillator<float> lfo;
+    juce::dsp::Oscillator<Type> lfo;
+};
+
+//==============================================================================
+/** Keeps a float and a double VoiceChain in step, and renders with whichever
+    matches the buffer, so a host running in double never goes through float.
+*/
+class Voice  : public juce::MPESynthesiserVoice
+{
+public:
+    //==============================================================================
+    void prepare (const juce::dsp::ProcessSpec& spec)
+    {
+        floatChain.prepare (spec);
+        doubleChain.prepare (spec);
+    }
+
+    //==============================================================================
+    void noteStarted() override
+    {
+        auto velocity = getCurrentlyPlayingNote().noteOnVelocity.asUnsignedFloat();
+        auto freqHz = getCurrentlyPlayingNote().getFrequencyInHertz();
+
+        floatChain.setFrequency ((float) freqHz, true);
+        floatChain.setLevel (velocity);
+
+        doubleChain.setFrequency (freqHz, true);
+        doubleChain.setLevel (velocity);
+    }
+
+    //==============================================================================
+    void notePitchbendChanged () override
+    {
+        auto freqHz = getCurrentlyPlayingNote().getFrequencyInHertz();
+        floatChain.setFrequency ((float) freqHz);
+        doubleChain.setFrequency (freqHz);
+    }
+
+    //==============================================================================
+    void noteStopped (bool) override
+    {
+        clearCurrentNote();
+    }
+
+    //==============================================================================
+    void notePressureChanged() override {}
+    void noteTimbreChanged() override   {}
+    void noteKeyStateChanged() override {}
+
+    //==============================================================================
+    void renderNextBlock (juce::AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override
+    {
+        doubleChain.renderNextBlock (outputBuffer, startSample, numSamples);
+    }
+
+    void renderNextBlock (juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
+    {
+        floatChain.renderNextBlock (outputBuffer, startSample, numSamples);
+    }
+
+private:
+    //==============================================================================
+    VoiceChain<float> floatChain;
+    VoiceChain<double> doubleChain;
 };
 
 //==============================================================================
@@ -401,6 +569,19 @@ public:
             dynamic_cast<Voice*> (v)->prepare (spec);
 
         fxChain.prepare (spec);
+        doubleDistortion.prepare (spec);
+        floatBuffer.setSize ((int) spec.numChannels, (int) spec.maximumBlockSize);
+    }
+
+    void setNonRealtime (bool isNonRealtime) noexcept
+    {
+        fxChain.get<cabSimulatorIndex>().setNonRealtime (isNonRealtime);
+    }
+
+    /** The oversampled distortion's delay, the same whichever precision renders. */
+    int getLatencyInSamples() const noexcept
+    {
+        return juce::roundToInt (fxChain.get<distortionIndex>().getLatencyInSamples());
     }
 
 private:
@@ -414,9 +595,31 @@ private:
 
     juce::dsp::ProcessorChain<Distortion<float>, CabSimulator<float>, juce::dsp::Reverb> fxChain;
 
+    // PartitionedConvolver and juce::dsp::Reverb only come in float, so in double
+    // the distortion runs natively and the cabinet and reverb run on a float copy
+    Distortion<double> doubleDistortion;
+    juce::AudioBuffer<float> floatBuffer;
+
     //==============================================================================
-    void renderNextSubBlock (juce::AudioBuffer<double>&, int, int) override
-    {}
+    void renderNextSubBlock (juce::AudioBuffer<double>& outputAudio, int startSample, int numSamples) override
+    {
+        MPESynthesiser::renderNextSubBlock (outputAudio, startSample, numSamples);
+
+        auto block = juce::dsp::AudioBlock<double> (outputAudio).getSubBlock ((size_t) startSample, (size_t) numSamples);
+        auto context = juce::dsp::ProcessContextReplacing<double> (block);
+        doubleDistortion.process (context);
+
+        auto floatBlock = juce::dsp::AudioBlock<float> (floatBuffer)
+                              .getSubsetChannelBlock (0, juce::jmin (block.getNumChannels(), (size_t) floatBuffer.getNumChannels()))
+                              .getSubBlock (0, (size_t) numSamples);
+        auto floatContext = juce::dsp::ProcessContextReplacing<float> (floatBlock);
+
+        copySamples (floatBlock, block);
+        fxChain.get<cabSimulatorIndex>().process (floatContext);
+        fxChain.get<reverbIndex>().process (floatContext);
+        copySamples (block, floatBlock);
+    }
+
     void renderNextSubBlock (juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) override
     {
         MPESynthesiser::renderNextSubBlock (outputAudio, startSample, numSamples);
@@ -425,6 +628,22 @@ private:
         auto context = juce::dsp::ProcessContextReplacing<float> (block);
         fxChain.process (context);
     }
+
+    template <typename DestType, typename SourceType>
+    static void copySamples (const juce::dsp::AudioBlock<DestType>& dest, const juce::dsp::AudioBlock<SourceType>& source) noexcept
+    {
+        auto numChannels = juce::jmin (dest.getNumChannels(), source.getNumChannels());
+        auto numSamples  = juce::jmin (dest.getNumSamples(), source.getNumSamples());
+
+        for (size_t channel = 0; channel < numChannels; ++channel)
+        {
+            auto* out = dest.getChannelPointer (channel);
+            auto* in  = source.getChannelPointer (channel);
+
+            for (size_t i = 0; i < numSamples; ++i)
+                out[i] = (DestType) in[i];
+        }
+    }
 };
 
 //==============================================================================
@@ -486,7 +705,11 @@ public:
     {}
 
     //==============================================================================
-    void process (const SampleType* data, size_t numSamples)
+    /** Takes samples of any type, so a processor running in double can feed a
+        float scope without converting its buffer first.
+    */
+    template <typename InputType>
+    void process (const InputType* data, size_t numSamples)
     {
         size_t index = 0;
 
@@ -494,7 +717,7 @@ public:
         {
             while (index++ < numSamples)
             {
-                auto currentSample = *data++;
+                auto currentSample = (SampleType) *data++;
 
                 if (currentSample >= triggerLevel && prevSample < triggerLevel)
                 {
@@ -511,7 +734,7 @@ public:
         {
             while (index++ < numSamples)
             {
-                buffer[numCollected++] = *data++;
+                buffer[numCollected++] = (SampleType) *data++;
 
                 if (numCollected == buffer.size())
                 {
@@ -648,6 +871,8 @@ public:
     void prepareToPlay (double sampleRate, int samplesPerBlock) override
     {
         audioEngine.prepare ({ sampleRate, (juce::uint32) samplesPerBlock, 2 });
+        audioEngine.setNonRealtime (isNonRealtime());
+        setLatencySamples (audioEngine.getLatencyInSamples());
         midiMessageCollector.reset (sampleRate);
     }
 
@@ -663,22 +888,16 @@ public:
 
         return true;
     }
-    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override
-    {}
+    bool supportsDoublePrecisionProcessing() const override                { return true; }
 
-    void processBlock (juce::AudioSampleBuffer& buffer, juce::MidiBuffer& midiMessages) override
+    void processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages) override
     {
-        juce::ScopedNoDenormals noDenormals;
-        auto totalNumInputChannels  = getTotalNumInputChannels();
-        auto totalNumOutputChannels = getTotalNumOutputChannels();
-
-        midiMessageCollector.removeNextBlockOfMessages (midiMessages, buffer.getNumSamples());
-
-        for (int i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-            buffer.clear (i, 0, buffer.getNumSamples());
+        process (buffer, midiMessages);
+    }
 
-        audioEngine.renderNextBlock (buffer, midiMessages, 0, buffer.getNumSamples());
-        scopeDataCollector.process (buffer.getReadPointer (0), (size_t) buffer.getNumSamples());
+    void processBlock (juce::AudioSampleBuffer& buffer, juce::MidiBuffer& midiMessages) override
+    {
+        process (buffer, midiMessages);
     }
 
     //==============================================================================
@@ -761,6 +980,23 @@ private:
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DSPTutorialAudioProcessorEditor)
     };
 
+    //==============================================================================
+    template <typename SampleType>
+    void process (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages)
+    {
+        juce::ScopedNoDenormals noDenormals;
+        auto totalNumInputChannels  = getTotalNumInputChannels();
+        auto totalNumOutputChannels = getTotalNumOutputChannels();
+
+        midiMessageCollector.removeNextBlockOfMessages (midiMessages, buffer.getNumSamples());
+
+        for (int i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+            buffer.clear (i, 0, buffer.getNumSamples());
+
+        audioEngine.renderNextBlock (buffer, midiMessages, 0, buffer.getNumSamples());
+        scopeDataCollector.process (buffer.getReadPointer (0), (size_t) buffer.getNumSamples());
+    }
+
     //==============================================================================
     AudioEngine audioEngine;
     juce::MidiMessageCollector midiMessageCollector;
@@ -115,12 +115,10 @@ public:
         const ScopedLock sl (innerMutex);
 
         active = true;
+        floatBuffer.setSize (jmax (getTotalNumInputChannels(), getTotalNumOutputChannels()), bs);
 
         if (inner != nullptr)
-        {
-            inner->setRateAndBufferSizeDetails (sr, bs);
-            inner->prepareToPlay (sr, bs);
-        }
+            prepareInner (sr, bs);
     }
 
     void releaseResources() final
@@ -145,7 +143,25 @@ public:
     // In a 'real' plugin, we'd need to add some synchronisation to ensure that the inner
     // plugin instance was never modified (deleted, replaced etc.) during a call to processBlock.
 
-    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override {}
+    bool supportsDoublePrecisionProcessing() const final              { return true; }
+
+    // An inner plugin that can't process doubles gets a float copy of the block instead.
+    void processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages) override
+    {
+        if (inner == nullptr)
+            return;
+
+        if (inner->isUsingDoublePrecision())
+        {
+            inner->processBlock (buffer, midiMessages);
+            return;
+        }
+
+        floatBuffer.makeCopyOf (buffer, true);
+        inner->processBlock (floatBuffer, midiMessages);
+        buffer.makeCopyOf (floatBuffer, true);
+    }
+
     void processBlock (juce::AudioSampleBuffer& buffer, juce::MidiBuffer& midiMessages) override
     {
         if(inner != nullptr)
@@ -243,10 +259,7 @@ public:
             // exactly match this layout.
 
             if (active)
-            {
-                inner->setRateAndBufferSizeDetails (getSampleRate(), getBlockSize());
-                inner->prepareToPlay (getSampleRate(), getBlockSize());
-            }
+                prepareInner (getSampleRate(), getBlockSize());
 
             NullCheckedInvocation::invoke (pluginChanged);
         };
@@ -286,11 +299,22 @@ private:
     std::unique_ptr<AudioPluginInstance> inner;
     EditorStyle editorStyle = EditorStyle{};
     bool active = false;
+    AudioBuffer<float> floatBuffer;
     ScopedMessageBox messageBox;
 
     static constexpr const char* innerStateTag = "inner_state";
     static constexpr const char* editorStyleTag = "editor_style";
 
+    void prepareInner (double sr, int bs)
+    {
+        // run the inner plugin in double too when it can, so nothing gets converted
+        const auto useDouble = isUsingDoublePrecision() && inner->supportsDoublePrecisionProcessing();
+        inner->setProcessingPrecision (useDouble ? doublePrecision : singlePrecision);
+
+        inner->setRateAndBufferSizeDetails (sr, bs);
+        inner->prepareToPlay (sr, bs);
+    }
+
     void changeListenerCallback (ChangeBroadcaster* source) final
     {
         if (source != &pluginList)
@@ -8,7 +8,13 @@
 
 #include <JuceHeader.h>
 #include "SynthUsingMidiInputTutorial_02.h"
+#include "SynthOfflineRender.h"
 
+//==============================================================================
+// lets SynthOfflineRender report allocations made on the audio thread
+ALLOCATION_COUNTER_REPLACE_OPERATOR_NEW
+
+//==============================================================================
 class Application    : public juce::JUCEApplication
 {
 public:
@@ -20,6 +26,16 @@ public:
 
     void initialise (const juce::String&) override
     {
+        // Synth --render --midi=file.mid [options] renders without a window or any devices
+        auto args = getCommandLineParameterArray();
+
+        if (args.contains (SynthOfflineRender::commandOption))
+        {
+            setApplicationReturnValue (SynthOfflineRender::run ({ getApplicationName(), args }));
+            quit();
+            return;
+        }
+
         mainWindow.reset (new MainWindow ("SynthUsingMidiInputTutorial", new MainContentComponent, *this));
     }
 
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "VoiceAllocator.h"
+
+//==============================================================================
+/** A voice that can say how loud it is, so that the quietest note can be the
+    one to give way.
+*/
+struct LevelReportingVoice
+{
+    virtual ~LevelReportingVoice() = default;
+
+    /** The voice's current gain, 0 to 1. */
+    virtual float getCurrentLevel() const noexcept = 0;
+};
+
+//==============================================================================
+/**
+    A juce::Synthesiser that only renders the voices that are sounding, and
+    hands out voices with a VoiceAllocator instead of searching for them.
+
+    The stock noteOn() and noteOff() walk every voice to find a free one, one
+    to steal, or the ones playing a note, and renderVoices() calls every voice
+    every block. Here the allocator answers all of those in O(1), and only its
+    sounding voices are rendered. A voice goes back to the allocator once it
+    has cleared its note, which is checked right after it renders.
+
+    setPolyphony() caps the number of notes held at once. Past that, the note
+    chosen by the stealing policy is released and tails off on its own voice
+    while the new note starts on a spare one. Voices that are a
+    LevelReportingVoice are ranked by level for the quietest policy.
+
+    The pedal and all-notes-off handlers still go through every voice, as
+    juce::Synthesiser does, and then tell the allocator what they released.
+
+    Each render publishes the sounding voice count, and
+    renderNextBlockTimed() also records how long the block took. The counts
+    are written while the synth's lock is held, and getStats() reads them
+    without it, from any thread.
+*/
+class ActiveVoiceSynthesiser   : public juce::Synthesiser
+{
+public:
+    struct Stats
+    {
+        int numActiveVoices = 0;
+        int numVoices = 0;
+        double blockMicroseconds = 0.0;
+        double peakBlockMicroseconds = 0.0;
+    };
+
+    ActiveVoiceSynthesiser() = default;
+
+    //==============================================================================
+    /** How many notes can be held at once; 0, the default, means one per voice.
+        Takes effect at the next setCurrentPlaybackSampleRate().
+    */
+    void setPolyphony (int maxHeldNotes) noexcept               { polyphony = maxHeldNotes; }
+
+    void setStealingPolicy (VoiceAllocator::StealingPolicy newPolicy)
+    {
+        const juce::ScopedLock sl (lock);
+        allocator.setStealingPolicy (newPolicy);
+    }
+
+    void setCurrentPlaybackSampleRate (double sampleRate) override
+    {
+        const juce::ScopedLock sl (lock);
+
+        juce::Synthesiser::setCurrentPlaybackSampleRate (sampleRate);
+
+        // the allocator starts out with every voice free
+        juce::Synthesiser::allNotesOff (0, false);
+
+        allocator.prepare (voices.size(), polyphony > 0 ? polyphony : voices.size());
+        levelReporters.resize ((size_t) voices.size());
+
+        for (auto index = 0; index < voices.size(); ++index)
+            levelReporters[(size_t) index] = dynamic_cast<LevelReportingVoice*> (voices.getUnchecked (index));
+
+        numVoices.store (voices.size(), std::memory_order_relaxed);
+        numActiveVoices.store (0, std::memory_order_relaxed);
+    }
+
+    void noteOn (int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        const juce::ScopedLock sl (lock);
+
+        jassert (allocator.getNumVoices() == voices.size());  // call setCurrentPlaybackSampleRate() after adding voices
+
+        for (auto* sound : sounds)
+        {
+            if (! (sound->appliesToNote (midiNoteNumber) && sound->appliesToChannel (midiChannel)))
+                continue;
+
+            // a note that is still ringing (perhaps held by a pedal) is stopped
+            // first, as juce::Synthesiser does
+            for (auto index = allocator.getFirstVoiceOnNote (midiChannel, midiNoteNumber);
+                 index != VoiceAllocator::noVoice;
+                 index = allocator.getNextVoiceOnNote (index))
+            {
+                if (allocator.isHeld (index))
+                    releaseVoice (index, 1.0f, true);
+            }
+
+            auto allocation = allocator.allocate (midiChannel, midiNoteNumber, isNoteStealingEnabled());
+
+            if (allocation.voiceToRelease != VoiceAllocator::noVoice)
+                voices.getUnchecked (allocation.voiceToRelease)->stopNote (1.0f, true);
+
+            if (allocation.voice != VoiceAllocator::noVoice)
+                startVoice (voices.getUnchecked (allocation.voice), sound, midiChannel, midiNoteNumber, velocity);
+        }
+    }
+
+    void noteOff (int midiChannel, int midiNoteNumber, float velocity, bool allowTailOff) override
+    {
+        const juce::ScopedLock sl (lock);
+
+        for (auto index = allocator.getFirstVoiceOnNote (midiChannel, midiNoteNumber);
+             index != VoiceAllocator::noVoice;
+             index = allocator.getNextVoiceOnNote (index))
+        {
+            auto* voice = voices.getUnchecked (index);
+
+            if (! (allocator.isHeld (index) && voice->isKeyDown()))
+                continue;
+
+            voice->setKeyDown (false);
+
+            if (! (voice->isSustainPedalDown() || voice->isSostenutoPedalDown()))
+                releaseVoice (index, velocity, allowTailOff);
+        }
+    }
+
+    void allNotesOff (int midiChannel, bool allowTailOff) override
+    {
+        const juce::ScopedLock sl (lock);
+
+        juce::Synthesiser::allNotesOff (midiChannel, allowTailOff);
+
+        auto& sounding = allocator.getSoundingVoices();
+
+        for (auto i = sounding.size(); --i >= 0;)
+        {
+            auto index = sounding[i];
+
+            if (! voices.getUnchecked (index)->isVoiceActive())
+                allocator.free (index);
+            else if (midiChannel <= 0 || allocator.getChannel (index) == midiChannel)
+                allocator.release (index);
+        }
+    }
+
+    void handleSustainPedal (int midiChannel, bool isDown) override
+    {
+        const juce::ScopedLock sl (lock);
+
+        juce::Synthesiser::handleSustainPedal (midiChannel, isDown);
+        releaseStoppedVoices();
+    }
+
+    void handleSostenutoPedal (int midiChannel, bool isDown) override
+    {
+        const juce::ScopedLock sl (lock);
+
+        juce::Synthesiser::handleSostenutoPedal (midiChannel, isDown);
+        releaseStoppedVoices();
+    }
+
+    //==============================================================================
+    /** renderNextBlock(), timed. */
+    template <typename FloatType>
+    void renderNextBlockTimed (juce::AudioBuffer<FloatType>& outputAudio, const juce::MidiBuffer& inputMidi,
+                               int startSample, int numSamples)
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+
+        renderNextBlock (outputAudio, inputMidi, startSample, numSamples);
+
+        auto microseconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start) * 1.0e6;
+
+        blockMicroseconds.store (microseconds, std::memory_order_relaxed);
+
+        if (microseconds > peakBlockMicroseconds.load (std::memory_order_relaxed))
+            peakBlockMicroseconds.store (microseconds, std::memory_order_relaxed);
+    }
+
+    Stats getStats() const noexcept
+    {
+        Stats stats;
+        stats.numActiveVoices       = numActiveVoices.load (std::memory_order_relaxed);
+        stats.numVoices             = numVoices.load (std::memory_order_relaxed);
+        stats.blockMicroseconds     = blockMicroseconds.load (std::memory_order_relaxed);
+        stats.peakBlockMicroseconds = peakBlockMicroseconds.load (std::memory_order_relaxed);
+        return stats;
+    }
+
+    void resetPeak() noexcept    { peakBlockMicroseconds.store (0.0, std::memory_order_relaxed); }
+
+    /** The lock the synth holds while it renders, for changing voice settings
+        from another thread.
+    */
+    const juce::CriticalSection& getLock() const noexcept    { return lock; }
+
+protected:
+    //==============================================================================
+    void renderVoices (juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) override
+    {
+        renderActiveVoices (outputAudio, startSample, numSamples);
+    }
+
+    void renderVoices (juce::AudioBuffer<double>& outputAudio, int startSample, int numSamples) override
+    {
+        renderActiveVoices (outputAudio, startSample, numSamples);
+    }
+
+private:
+    //==============================================================================
+    template <typename FloatType>
+    void renderActiveVoices (juce::AudioBuffer<FloatType>& outputAudio, int startSample, int numSamples)
+    {
+        auto& sounding = allocator.getSoundingVoices();
+
+        // backwards, so that freeing a voice only moves ones already rendered
+        for (auto i = sounding.size(); --i >= 0;)
+        {
+            auto index = sounding[i];
+            auto* voice = voices.getUnchecked (index);
+
+            voice->renderNextBlock (outputAudio, startSample, numSamples);
+
+            if (! voice->isVoiceActive())
+                allocator.free (index);
+            else if (auto* reporter = levelReporters[(size_t) index])
+                allocator.setLevel (index, reporter->getCurrentLevel());
+        }
+
+        numActiveVoices.store (sounding.size(), std::memory_order_relaxed);
+    }
+
+    void releaseVoice (int index, float velocity, bool allowTailOff)
+    {
+        allocator.release (index);
+        voices.getUnchecked (index)->stopNote (velocity, allowTailOff);
+    }
+
+    /** Catches up with voices that juce::Synthesiser stopped on its own. */
+    void releaseStoppedVoices() noexcept
+    {
+        auto& sounding = allocator.getSoundingVoices();
+
+        for (auto i = sounding.size(); --i >= 0;)
+        {
+            auto index = sounding[i];
+            auto* voice = voices.getUnchecked (index);
+
+            if (! voice->isVoiceActive())
+                allocator.free (index);
+            else if (allocator.isHeld (index) && ! voice->isKeyDown()
+                     && ! (voice->isSustainPedalDown() || voice->isSostenutoPedalDown()))
+                allocator.release (index);
+        }
+    }
+
+    VoiceAllocator allocator;
+    std::vector<LevelReportingVoice*> levelReporters;
+    int polyphony = 0;
+
+    std::atomic<int> numActiveVoices { 0 }, numVoices { 0 };
+    std::atomic<double> blockMicroseconds { 0.0 }, peakBlockMicroseconds { 0.0 };
+
+    JUCE_DECLARE_NON_COPYABLE (ActiveVoiceSynthesiser)
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include "AllocationCounter.h"
+#include "CommandLineOptions.h"
+#include "OfflineRenderReport.h"
+#include "SynthUsingMidiInputTutorial_02.h"
+
+//==============================================================================
+/**
+    Plays a Standard MIDI File through SynthAudioSource without an audio device
+    or a MIDI input, as fast as it goes, and reports how long each block took.
+
+    All the tracks are merged and every event lands on the sample its time
+    stamp rounds to, so two runs of the same build render identical audio. The
+    render runs on past the last event for the length of the tail. Only the
+    synth's render call is timed; building each block's MidiBuffer and writing
+    the optional WAV file happen outside that time.
+
+    Options: --midi=file.mid (required), --output=file.wav (otherwise discarded),
+             --bits=16|24|32 (32, float), --block-size=N (512),
+             --sample-rate=N (48000), --tail=seconds (2)
+*/
+struct SynthOfflineRender
+{
+    static constexpr const char* commandOption = "--render";
+
+    static int run (const juce::ArgumentList& args)
+    {
+        auto blockSize      = CommandLineOptions::getInt (args, "--block-size", 512);
+        auto sampleRate     = (double) CommandLineOptions::getInt (args, "--sample-rate", 48000);
+        auto tailSeconds    = CommandLineOptions::getInt (args, "--tail", 2, 0);
+        auto bitsPerSample  = CommandLineOptions::getInt (args, "--bits", 32);
+
+        if (bitsPerSample != 16 && bitsPerSample != 24 && bitsPerSample != 32)
+        {
+            std::cerr << "--bits must be 16, 24 or 32" << std::endl;
+            return 1;
+        }
+
+        if (args.getValueForOption ("--midi").isEmpty())
+        {
+            std::cerr << "Give the MIDI file to render with --midi=file.mid" << std::endl;
+            return 1;
+        }
+
+        juce::MidiMessageSequence sequence;
+
+        if (! readMidiFile (args.getFileForOption ("--midi"), sequence))
+        {
+            std::cerr << "Couldn't read " << args.getValueForOption ("--midi") << " as a MIDI file" << std::endl;
+            return 1;
+        }
+
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+
+        if (args.containsOption ("--output"))
+        {
+            writer = OfflineRenderReport::createWavWriter (args.getFileForOption ("--output"), sampleRate, bitsPerSample);
+
+            if (writer == nullptr)
+            {
+                std::cerr << "Couldn't open " << args.getValueForOption ("--output") << " for writing" << std::endl;
+                return 1;
+            }
+        }
+
+        juce::MidiKeyboardState keyboardState;
+        SynthAudioSource source (keyboardState);
+        source.prepareToPlay (blockSize, sampleRate);
+
+        auto lengthSeconds = sequence.getEndTime() + tailSeconds;
+        auto numBlocks = (int) std::ceil (lengthSeconds * sampleRate / blockSize);
+
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        midi.ensureSize (4096);
+
+        std::vector<double> blockSeconds;
+        blockSeconds.reserve ((size_t) numBlocks);
+        juce::uint64 numAllocations = 0;
+        auto peakVoices = 0;
+        auto nextEvent = 0;
+
+        for (auto block = 0; block < numBlocks; ++block)
+        {
+            auto blockStart = (juce::int64) block * blockSize;
+            nextEvent = fillBlock (midi, sequence, nextEvent, blockStart, blockSize, sampleRate);
+
+            juce::AudioSourceChannelInfo bufferToFill (buffer);
+
+            auto allocationsBefore = AllocationCounter::getCount();
+            auto start = juce::Time::getHighResolutionTicks();
+
+            source.renderNextBlock (bufferToFill, midi);
+
+            auto end = juce::Time::getHighResolutionTicks();
+            numAllocations += AllocationCounter::getCount() - allocationsBefore;
+            blockSeconds.push_back (juce::Time::highResolutionTicksToSeconds (end - start));
+            peakVoices = juce::jmax (peakVoices, source.getStats().numActiveVoices);
+
+            if (writer != nullptr)
+                writer->writeFromAudioSampleBuffer (buffer, 0, blockSize);
+        }
+
+        source.releaseResources();
+
+        std::cout << sequence.getNumEvents() << " MIDI events, " << lengthSeconds << " s, peak "
+                  << peakVoices << " of " << source.getStats().numVoices << " voices" << std::endl;
+
+        OfflineRenderReport::print (blockSeconds, numAllocations, blockSize, sampleRate);
+        return 0;
+    }
+
+private:
+    //==============================================================================
+    /** Merges every track into one sequence, timed in seconds. */
+    static bool readMidiFile (const juce::File& file, juce::MidiMessageSequence& sequence)
+    {
+        juce::FileInputStream stream (file);
+        juce::MidiFile midiFile;
+
+        if (! stream.openedOk() || ! midiFile.readFrom (stream))
+            return false;
+
+        midiFile.convertTimestampTicksToSeconds();
+
+        for (auto track = 0; track < midiFile.getNumTracks(); ++track)
+            sequence.addSequence (*midiFile.getTrack (track), 0.0);
+
+        sequence.updateMatchedPairs();
+        return true;
+    }
+
+    /** Puts the events that fall in this block into the buffer, and returns the
+        index of the first one that doesn't.
+    */
+    static int fillBlock (juce::MidiBuffer& midi, const juce::MidiMessageSequence& sequence, int nextEvent,
+                          juce::int64 blockStart, int blockSize, double sampleRate)
+    {
+        midi.clear();
+
+        for (; nextEvent < sequence.getNumEvents(); ++nextEvent)
+        {
+            auto& message = sequence.getEventPointer (nextEvent)->message;
+            auto position = (juce::int64) std::llround (message.getTimeStamp() * sampleRate) - blockStart;
+
+            if (position >= blockSize)
+                break;
+
+            if (! message.isMetaEvent())
+                midi.addEvent (message, (int) juce::jmax ((juce::int64) 0, position));
+        }
+
+        return nextEvent;
+    }
+};
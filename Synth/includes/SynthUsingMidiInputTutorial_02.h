@@ -47,10 +47,12 @@
 
 #pragma once
 #include <math.h>
-#include <float.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_audio_basics/juce_audio_basics.h>
-
+#include "ActiveVoiceSynthesiser.h"
+#include "AdsrEnvelope.h"
+#include "MidiEventQueue.h"
+#include "PartialBank.h"
 
 //==============================================================================
 struct SineWaveSound   : public juce::SynthesiserSound
@@ -62,106 +64,189 @@ struct SineWaveSound   : public juce::SynthesiserSound
 };
 
 //==============================================================================
-struct SineWaveVoice   : public juce::SynthesiserVoice
+/**
+    Plays a note as a stack of harmonic partials from one PartialBank, so a key
+    press takes a single voice however many partials it has. The partials start
+    on a sawtooth spectrum (1 / k) and can be reshaped with setPartialAmplitude().
+*/
+struct AdditiveVoice   : public juce::SynthesiserVoice,
+                         public LevelReportingVoice
 {
-    SineWaveVoice(int _harm): harm{_harm} {}
+    explicit AdditiveVoice (int numPartials)
+    {
+        partials.prepare (numPartials, voiceBufferSize);
+
+        for (auto partial = 1; partial <= numPartials; ++partial)
+            partials.setAmplitude (partial, 1.0f / (float) partial);
+
+        // a short attack against clicks, and a release about as long as the
+        // old fixed 0.99-per-sample tail-off
+        envelope.setParameters ({ 0.002f, 0.1f, 1.0f, 0.012f });
+    }
+
+    void setPartialAmplitude (int partial, float amplitude) noexcept
+    {
+        partials.setAmplitude (partial, amplitude);
+    }
 
     bool canPlaySound (juce::SynthesiserSound* sound) override
     {
         return dynamic_cast<SineWaveSound*> (sound) != nullptr;
     }
 
+    /** The envelope's coefficients follow the rate, so they're worked out
+        here instead of on every note-on.
+    */
+    void setCurrentPlaybackSampleRate (double newRate) override
+    {
+        SynthesiserVoice::setCurrentPlaybackSampleRate (newRate);
+
+        if (newRate > 0.0)
+            envelope.setSampleRate (newRate);
+    }
+
     void startNote (int midiNoteNumber, float velocity,
                     juce::SynthesiserSound*, int /*currentPitchWheelPosition*/) override
     {
-        currentAngle = 0.0;
         level = velocity * 0.15;
-        tailOff = 0.0;
 
-        auto cyclesPerSecond = juce::MidiMessage::getMidiNoteInHertz (midiNoteNumber);
-        auto cyclesPerSample = harm * cyclesPerSecond / getSampleRate();
-
-        angleDelta = cyclesPerSample * 2.0 * juce::MathConstants<double>::pi;
+        partials.resetPhases();
+        partials.setFrequency (juce::MidiMessage::getMidiNoteInHertz (midiNoteNumber), getSampleRate());
+        envelope.noteOn();
     }
 
     void stopNote (float /*velocity*/, bool allowTailOff) override
     {
         if (allowTailOff)
         {
-            if (fabs(tailOff - 0.0) < DBL_EPSILON)
-                tailOff = 1.0;
+            envelope.noteOff();
         }
         else
         {
+            envelope.reset();
             clearCurrentNote();
-            angleDelta = 0.0;
         }
     }
 
     void pitchWheelMoved (int) override      {}
     void controllerMoved (int, int) override {}
-    
-    void renderNextBlock (juce::AudioBuffer<double>&, int, int) override {}
 
-    void renderNextBlock (juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override
+    float getCurrentLevel() const noexcept override
     {
-        if (fabs(angleDelta - 0.0) > DBL_EPSILON)
-        {
-            if (fabs(tailOff - 0.0) > DBL_EPSILON) // [7]
-            {
-                while (--numSamples >= 0)
-                {
-                    auto currentSample = (float) (std::sin (currentAngle) * level * tailOff) / harm;
+        return envelope.getLevel() * (float) level;
+    }
 
-                    for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
-                        outputBuffer.addSample (i, startSample, currentSample);
+    void renderNextBlock (juce::AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override
+    {
+        renderVoice (outputBuffer, startSample, numSamples);
+    }
 
-                    currentAngle += angleDelta;
-                    ++startSample;
+    void renderNextBlock (juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override
+    {
+        renderVoice (outputBuffer, startSample, numSamples);
+    }
+
+private:
+    static constexpr int voiceBufferSize = 256;
 
-                    tailOff *= 0.99; // [8]
+    /** The partials and the envelope run in float whatever the buffer type; only
+        the level and the mix into the output follow FloatType.
+    */
+    template <typename FloatType>
+    void renderVoice (juce::AudioBuffer<FloatType>& outputBuffer, int startSample, int numSamples)
+    {
+        if (! envelope.isActive())
+            return;
 
-                    if (tailOff < 0.005)
-                    {
-                        clearCurrentNote(); // [9]
+        while (numSamples > 0)
+        {
+            auto numThisTime = juce::jmin (numSamples, voiceBufferSize);
+            auto numActive = envelope.process (envelopeBuffer, numThisTime);
 
-                        angleDelta = 0.0;
-                        break;
-                    }
-                }
-            }
-            else
-            {
-                while (--numSamples >= 0) // [6]
-                {
-                    auto currentSample = (float) (std::sin (currentAngle) * level);
+            juce::FloatVectorOperations::clear (voiceBuffer, numActive);
+            partials.renderNextBlock (voiceBuffer, numActive);
+            juce::FloatVectorOperations::multiply (voiceBuffer, envelopeBuffer, numActive);
 
-                    for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
-                        outputBuffer.addSample (i, startSample, currentSample);
+            for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
+                addVoiceBuffer (outputBuffer.getWritePointer (i, startSample), numActive);
 
-                    currentAngle += angleDelta;
-                    ++startSample;
-                }
+            if (! envelope.isActive())
+            {
+                clearCurrentNote();
+                return;
             }
+
+            startSample += numThisTime;
+            numSamples -= numThisTime;
         }
     }
 
-private:
-    double currentAngle = 0.0, angleDelta = 0.0, level = 0.0, tailOff = 0.0;
-    int harm;
+    void addVoiceBuffer (float* destination, int numSamples) noexcept
+    {
+        juce::FloatVectorOperations::addWithMultiply (destination, voiceBuffer, (float) level, numSamples);
+    }
+
+    void addVoiceBuffer (double* destination, int numSamples) noexcept
+    {
+        for (auto i = 0; i < numSamples; ++i)
+            destination[i] += level * voiceBuffer[i];
+    }
+
+    PartialBank partials;
+    AdsrEnvelope envelope;
+    float voiceBuffer[voiceBufferSize], envelopeBuffer[voiceBufferSize];
+    double level = 0.0;
 };
 
 //==============================================================================
-class SynthAudioSource   : public juce::AudioSource
+/**
+    Plays the MIDI input and the on-screen keyboard through an
+    ActiveVoiceSynthesiser.
+
+    Both reach the audio thread through a MidiEventQueue of their own, since
+    each queue takes one writer: the MIDI input thread pushes into one, and
+    the keyboard's listener callbacks push into the other on the message
+    thread. The audio thread merges them without locking either, and is then
+    the only thread that plays notes on the synth.
+*/
+class SynthAudioSource   : public juce::AudioSource,
+                           private juce::MidiKeyboardState::Listener
 {
 public:
+    static constexpr int numVoices = 24;
+    static constexpr int polyphony = 16;    // the other voices are for the tails of stolen notes
+    static constexpr int numPartials = 20;
+
     SynthAudioSource (juce::MidiKeyboardState& keyState)
         : keyboardState (keyState)
     {
-        for (auto i = 0; i < 20; ++i)
-            synth.addVoice (new SineWaveVoice(i + 1));
+        for (auto i = 0; i < numVoices; ++i)
+            synth.addVoice (new AdditiveVoice (numPartials));
+
+        synth.setPolyphony (polyphony);
 
         synth.addSound (new SineWaveSound());
+
+        keyboardState.addListener (this);
+    }
+
+    ~SynthAudioSource() override
+    {
+        keyboardState.removeListener (this);
+    }
+
+    /** Reshapes the spectrum of every voice, starting from the fundamental.
+        This takes the lock that the audio thread holds while it renders, so
+        the audio thread may wait for it; call it while nothing is playing.
+    */
+    void setPartialAmplitudes (const juce::Array<float>& amplitudes)
+    {
+        const juce::ScopedLock sl (synth.getLock());
+
+        for (auto i = 0; i < synth.getNumVoices(); ++i)
+            if (auto* voice = dynamic_cast<AdditiveVoice*> (synth.getVoice (i)))
+                for (auto partial = 1; partial <= juce::jmin (numPartials, amplitudes.size()); ++partial)
+                    voice->setPartialAmplitude (partial, amplitudes[partial - 1]);
     }
 
     void setUsingSineWaveSound()
@@ -169,37 +254,94 @@ public:
         synth.clearSounds();
     }
 
-    void prepareToPlay (int /*samplesPerBlockExpected*/, double sampleRate) override
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
     {
         synth.setCurrentPlaybackSampleRate (sampleRate);
-        midiCollector.reset (sampleRate); // [10]
+        midiInput.queue.reset (sampleRate); // [10]
+        midiInput.queue.setLatency (samplesPerBlockExpected / sampleRate + midiJitterMargin);
+        keyboardQueue.reset (sampleRate);
+        keyboardQueue.setLatency (samplesPerBlockExpected / sampleRate + midiJitterMargin);
+
+        // room for both queues full
+        incomingMidi.ensureSize (MidiEventQueue::getBytesNeededForBuffer (MidiEventQueue::capacity));
     }
 
     void releaseResources() override {}
 
     void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override
+    {
+        incomingMidi.clear();
+        midiInput.queue.removeNextBlockOfMessages (incomingMidi, bufferToFill.numSamples); // [11]
+        keyboardQueue.removeNextBlockOfMessages (incomingMidi, bufferToFill.numSamples);
+
+        renderNextBlock (bufferToFill, incomingMidi);
+    }
+
+    /** Renders a block driven by the given MIDI alone, instead of the MIDI
+        input and the keyboard, for SynthOfflineRender.
+    */
+    void renderNextBlock (const juce::AudioSourceChannelInfo& bufferToFill, const juce::MidiBuffer& midi)
     {
         bufferToFill.clearActiveBufferRegion();
 
-        juce::MidiBuffer incomingMidi;
-        midiCollector.removeNextBlockOfMessages (incomingMidi, bufferToFill.numSamples); // [11]
+        synth.renderNextBlockTimed (*bufferToFill.buffer, midi,
+                                    bufferToFill.startSample, bufferToFill.numSamples);
+    }
 
-        keyboardState.processNextMidiBuffer (incomingMidi, bufferToFill.startSample,
-                                             bufferToFill.numSamples, true);
+    juce::MidiInputCallback* getMidiInputCallback()
+    {
+        return &midiInput;
+    }
 
-        synth.renderNextBlock (*bufferToFill.buffer, incomingMidi,
-                               bufferToFill.startSample, bufferToFill.numSamples);
+    ActiveVoiceSynthesiser::Stats getStats() const noexcept
+    {
+        return synth.getStats();
     }
 
-    juce::MidiMessageCollector* getMidiCollector()
+    MidiEventQueue::JitterStats getMidiJitterStats() const noexcept
     {
-        return &midiCollector;
+        return midiInput.queue.getJitterStats();
+    }
+
+    /** Extra MIDI latency, on top of one block, to absorb callback jitter. */
+    void setMidiJitterMargin (double seconds) noexcept
+    {
+        midiJitterMargin = seconds;
     }
 
 private:
+    //==============================================================================
+    // stamped like juce::MidiInput's messages, so both queues time them alike
+    void handleNoteOn (juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        keyboardQueue.push (juce::MidiMessage::noteOn (midiChannel, midiNoteNumber, velocity)
+                                .withTimeStamp (juce::Time::getMillisecondCounterHiRes() * 0.001));
+    }
+
+    void handleNoteOff (juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        keyboardQueue.push (juce::MidiMessage::noteOff (midiChannel, midiNoteNumber, velocity)
+                                .withTimeStamp (juce::Time::getMillisecondCounterHiRes() * 0.001));
+    }
+
     juce::MidiKeyboardState& keyboardState;
-    juce::Synthesiser synth;
-    juce::MidiMessageCollector midiCollector;
+
+    //==============================================================================
+    struct MidiInputReceiver   : public juce::MidiInputCallback
+    {
+        void handleIncomingMidiMessage (juce::MidiInput*, const juce::MidiMessage& message) override
+        {
+            queue.push (message);
+        }
+
+        MidiEventQueue queue;
+    };
+
+    ActiveVoiceSynthesiser synth;
+    MidiInputReceiver midiInput;
+    MidiEventQueue keyboardQueue;
+    juce::MidiBuffer incomingMidi;
+    double midiJitterMargin = 0.002;
 };
 
 //==============================================================================
@@ -239,9 +381,10 @@ public:
             setMidiInput (0);
 
         addAndMakeVisible (keyboardComponent);
+        addAndMakeVisible (statsLabel);
         setAudioChannels (0, 2);
 
-        setSize (600, 190);
+        setSize (600, 220);
         startTimer (400);
     }
 
@@ -253,7 +396,8 @@ public:
     void resized() override
     {
         midiInputList    .setBounds (200, 10, getWidth() - 210, 20);
-        keyboardComponent.setBounds (10,  40, getWidth() - 20, getHeight() - 50);
+        keyboardComponent.setBounds (10,  40, getWidth() - 20, getHeight() - 80);
+        statsLabel       .setBounds (10, getHeight() - 35, getWidth() - 20, 25);
     }
 
     void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
@@ -274,8 +418,21 @@ public:
 private:
     void timerCallback() override
     {
-        keyboardComponent.grabKeyboardFocus();
-        stopTimer();
+        if (! hasGrabbedFocus)
+        {
+            keyboardComponent.grabKeyboardFocus();
+            hasGrabbedFocus = true;
+        }
+
+        auto stats = synthAudioSource.getStats();
+        auto midi = synthAudioSource.getMidiJitterStats();
+
+        statsLabel.setText ("Voices: " + juce::String (stats.numActiveVoices) + " / " + juce::String (stats.numVoices)
+                              + "   Block: " + juce::String (stats.blockMicroseconds, 1) + " us"
+                              + " (peak " + juce::String (stats.peakBlockMicroseconds, 1) + " us)"
+                              + "   MIDI jitter: " + juce::String (juce::roundToInt (midi.callbackRmsMicroseconds)) + " us rms"
+                              + ", late " + juce::String (midi.numLateEvents),
+                            juce::dontSendNotification);
     }
 
     void setMidiInput (int index)
@@ -283,14 +440,14 @@ private:
         auto list = juce::MidiInput::getAvailableDevices();
 
         deviceManager.removeMidiInputDeviceCallback (list[lastInputIndex].identifier,
-                                                     synthAudioSource.getMidiCollector()); // [12]
+                                                     synthAudioSource.getMidiInputCallback()); // [12]
 
         auto newInput = list[index];
 
         if (! deviceManager.isMidiInputDeviceEnabled (newInput.identifier))
             deviceManager.setMidiInputDeviceEnabled (newInput.identifier, true);
 
-        deviceManager.addMidiInputDeviceCallback (newInput.identifier, synthAudioSource.getMidiCollector()); // [13]
+        deviceManager.addMidiInputDeviceCallback (newInput.identifier, synthAudioSource.getMidiInputCallback()); // [13]
         midiInputList.setSelectedId (index + 1, juce::dontSendNotification);
 
         lastInputIndex = index;
@@ -303,7 +460,9 @@ private:
 
     juce::ComboBox midiInputList;
     juce::Label midiInputListLabel;
+    juce::Label statsLabel;
     int lastInputIndex = 0;
+    bool hasGrabbedFocus = false;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainContentComponent)
 };
@@ -1,6 +1,29 @@
 #include <gtest/gtest.h>
+#include <complex>
+#include <set>
+#include <thread>
 #include "PluginProcessor.h"
 #include <juce_dsp/juce_dsp.h>
+#include "WavetableOscillator.h"
+#include "WavetableOscillatorBank.h"
+#include "MipmappedWavetable.h"
+#include "WavetableExchange.h"
+#include "WavetableRenderPool.h"
+#include "WavetableInterpolation.h"
+#include "WavetableCache.h"
+#include "WavetableUnison.h"
+#include "BlockSineGenerator.h"
+#include "AdsrEnvelope.h"
+#include "ActiveVoiceList.h"
+#include "VoiceAllocator.h"
+#include "ActiveVoiceSynthesiser.h"
+#include "PartialBank.h"
+#include "MidiEventQueue.h"
+#include "MidiClockMapper.h"
+#include "PartitionedConvolver.h"
+#include "ImpulseResponseCache.h"
+#include "ImpulseResponseSpectrumFile.h"
+#include "AntialiasedTanh.h"
 
 namespace test_plugins
 {
@@ -16,4 +39,1267 @@ namespace test_plugins
         EXPECT_EQ(1.0, osc.getFrequency());
     }
 
-} // namespace test_plugins
\ No newline at end of file
+    static juce::AudioSampleBuffer makeTestWavetable(int tableSize)
+    {
+        juce::AudioSampleBuffer table(1, tableSize + 1);
+        auto *samples = table.getWritePointer(0);
+
+        for (auto i = 0; i < tableSize; ++i)
+        {
+            auto angle = juce::MathConstants<double>::twoPi * i / tableSize;
+            samples[i] = (float)(0.5 * std::sin(angle) + 0.1 * std::sin(3.0 * angle));
+        }
+
+        samples[tableSize] = samples[0];
+        return table;
+    }
+
+    TEST(WavetableOscillatorBank, MatchesPerObjectOscillators)
+    {
+        auto table = makeTestWavetable(128);
+        const auto sampleRate = 48000.0f;
+        const auto numOscillators = 37; // deliberately not a multiple of the lane width
+        const auto level = 0.25f / (float)numOscillators;
+
+        juce::OwnedArray<WavetableOscillator> oscillators;
+        WavetableOscillatorBank bank;
+        bank.prepare(numOscillators, 256);
+        bank.setWavetable(table);
+
+        juce::Random random(42);
+
+        for (auto i = 0; i < numOscillators; ++i)
+        {
+            auto frequency = 100.0f + random.nextFloat() * 2000.0f;
+            oscillators.add(new WavetableOscillator(table))->setFrequency(frequency, sampleRate);
+            bank.addOscillator(frequency, sampleRate, level);
+        }
+
+        // longer than the prepared block size, so the bank has to split it
+        const auto numSamples = 1000;
+        std::vector<float> expected((size_t)numSamples), left((size_t)numSamples), right((size_t)numSamples);
+
+        for (auto block = 0; block < 8; ++block)
+        {
+            std::fill(expected.begin(), expected.end(), 0.0f);
+            std::fill(left.begin(), left.end(), 0.0f);
+            std::fill(right.begin(), right.end(), 0.0f);
+
+            for (auto *oscillator : oscillators)
+                for (auto sample = 0; sample < numSamples; ++sample)
+                    expected[(size_t)sample] += oscillator->getNextSample() * level;
+
+            bank.renderNextBlock(left.data(), right.data(), numSamples);
+
+            // centred oscillators play at full gain in both channels
+            for (auto sample = 0; sample < numSamples; ++sample)
+            {
+                ASSERT_NEAR(expected[(size_t)sample], left[(size_t)sample], 1.0e-6f);
+                ASSERT_EQ(left[(size_t)sample], right[(size_t)sample]);
+            }
+        }
+    }
+
+    TEST(WavetableOscillatorBank, PanAndGainRampToTheirTargets)
+    {
+        // a constant table, so the output is the gain itself
+        juce::AudioSampleBuffer table(1, 129);
+
+        for (auto i = 0; i <= 128; ++i)
+            table.setSample(0, i, 1.0f);
+
+        const auto sampleRate = 48000.0f;
+        const auto numSamples = 1024;
+
+        WavetableOscillatorBank bank;
+        bank.prepare(1, numSamples);
+        bank.setWavetable(table);
+        bank.setSmoothingTime(0.001f, sampleRate);
+        bank.addOscillator(100.0f, sampleRate, 0.5f);
+
+        bank.setPan(0, 1.0f);
+        bank.setGain(0, 1.0f);
+
+        std::vector<float> left((size_t)numSamples, 0.0f), right((size_t)numSamples, 0.0f);
+        bank.renderNextBlock(left.data(), right.data(), numSamples);
+
+        // no jump at the start of the ramp, and it keeps moving towards the target
+        EXPECT_GT(left[0], 0.48f);
+        EXPECT_LT(right[0], 0.52f);
+
+        for (auto i = 1; i < numSamples; ++i)
+        {
+            ASSERT_LE(left[(size_t)i], left[(size_t)i - 1]);
+            ASSERT_GE(right[(size_t)i], right[(size_t)i - 1]);
+        }
+
+        EXPECT_NEAR(0.0f, left.back(), 1.0e-6f);
+        EXPECT_NEAR(1.0f, right.back(), 1.0e-4f);
+
+        std::fill(left.begin(), left.end(), 0.0f);
+        std::fill(right.begin(), right.end(), 0.0f);
+        bank.renderNextBlock(left.data(), right.data(), numSamples);
+
+        EXPECT_EQ(0.0f, left[0]);
+        EXPECT_EQ(1.0f, right[0]);
+    }
+
+    TEST(WavetableUnison, SpreadsVoicesSymmetricallyAroundTheNote)
+    {
+        auto table = makeTestWavetable(128);
+
+        WavetableOscillatorBank bank;
+        bank.prepare(10, 256);
+        bank.setWavetable(table);
+        bank.addOscillator(100.0f, 48000.0f, 1.0f);
+
+        UnisonSettings unison;
+        unison.numVoices = 7;
+        unison.detuneCents = 30.0f;
+        unison.stereoSpread = 0.5f;
+
+        juce::Random random(3);
+        auto first = WavetableUnison::addStack(bank, 440.0f, 48000.0f, 0.7f, 0.2f, unison, random);
+
+        EXPECT_EQ(1, first);
+        EXPECT_EQ(8, bank.size());
+        EXPECT_NEAR(440.0f * std::exp2(-30.0f / 1200.0f), bank.getFrequency(first), 1.0e-3f);
+        EXPECT_NEAR(440.0f, bank.getFrequency(first + 3), 1.0e-3f);
+        EXPECT_NEAR(440.0f * std::exp2(30.0f / 1200.0f), bank.getFrequency(first + 6), 1.0e-3f);
+
+        for (auto voice = 0; voice < 7; ++voice)
+        {
+            // 1 / sqrt (7) keeps the stack about as loud as one voice
+            EXPECT_NEAR(0.7f / std::sqrt(7.0f), bank.getGain(first + voice), 1.0e-6f);
+            EXPECT_NEAR(0.2f + 0.5f * (voice / 3.0f - 1.0f), bank.getPan(first + voice), 1.0e-6f);
+        }
+    }
+
+
+    TEST(MipmappedWavetable, LevelsDropHarmonicsAboveTheirLimit)
+    {
+        auto source = makeTestWavetable(128);
+        const size_t budget = 32 * 1024;
+
+        MipmappedWavetable mipmaps;
+        mipmaps.build(source, budget);
+
+        EXPECT_LE(mipmaps.getMemoryUsage(), budget);
+        EXPECT_GT(mipmaps.getNumLevels(), 1);
+
+        for (auto &level : mipmaps.getLevels())
+        {
+            auto *samples = mipmaps.getData() + level.offset;
+            auto thirdHarmonic = level.maxHarmonic >= 3 ? 0.1 : 0.0;
+
+            for (auto i = 0; i <= level.size; ++i)
+            {
+                auto angle = juce::MathConstants<double>::twoPi * i / level.size;
+                auto expected = 0.5 * std::sin(angle) + thirdHarmonic * std::sin(3.0 * angle);
+                ASSERT_NEAR(expected, samples[i], 1.0e-5);
+            }
+        }
+    }
+
+    TEST(MipmappedWavetable, BankPicksBandLimitedLevelForHighNotes)
+    {
+        auto source = makeTestWavetable(128);
+        MipmappedWavetable mipmaps;
+        mipmaps.build(source, 32 * 1024);
+
+        // the third harmonic of 10 kHz would fold back at 48 kHz
+        const auto sampleRate = 48000.0f, frequency = 10000.0f;
+
+        WavetableOscillatorBank bank;
+        bank.prepare(1, 512);
+        bank.setWavetable(mipmaps);
+        bank.addOscillator(frequency, sampleRate, 1.0f);
+
+        std::vector<float> output(512, 0.0f), right(512, 0.0f);
+        bank.renderNextBlock(output.data(), right.data(), (int)output.size());
+
+        for (size_t i = 0; i < output.size(); ++i)
+        {
+            auto expected = 0.5 * std::sin(juce::MathConstants<double>::twoPi * frequency * (double)i / sampleRate);
+            ASSERT_NEAR(expected, output[i], 2.0e-3);
+        }
+    }
+
+
+    TEST(WavetableExchange, ReclaimsTablesOnlyAfterTheReaderMovesOn)
+    {
+        WavetableExchange<juce::AudioSampleBuffer> exchange;
+        EXPECT_EQ(nullptr, exchange.acquire());
+
+        exchange.publish(std::make_unique<juce::AudioSampleBuffer>(makeTestWavetable(128)));
+        auto *first = exchange.acquire();
+        ASSERT_NE(nullptr, first);
+
+        WavetableOscillator oscillator(*first);
+        oscillator.setFrequency(440.0f, 48000.0f);
+
+        // the reader hasn't acknowledged the new table yet, so both must stay alive
+        exchange.publish(std::make_unique<juce::AudioSampleBuffer>(makeTestWavetable(256)));
+        exchange.collectGarbage();
+        EXPECT_EQ(2, exchange.getNumLiveTables());
+
+        auto *second = exchange.acquire();
+        EXPECT_NE(first, second);
+        oscillator.setWavetable(*second);
+        oscillator.getNextSample();
+
+        exchange.collectGarbage();
+        EXPECT_EQ(1, exchange.getNumLiveTables());
+        EXPECT_EQ(second, exchange.acquire());
+    }
+
+
+    TEST(WavetableRenderPool, MatchesSingleThreadedBank)
+    {
+        auto table = makeTestWavetable(128);
+        const auto numOscillators = 1000, blockSize = 256;
+
+        WavetableOscillatorBank single, shared;
+
+        for (auto *bank : {&single, &shared})
+        {
+            bank->prepare(numOscillators, blockSize);
+            bank->setWavetable(table);
+
+            juce::Random random(7);
+
+            for (auto i = 0; i < numOscillators; ++i)
+                bank->addOscillator(50.0f + random.nextFloat() * 5000.0f, 48000.0f, 1.0f / numOscillators,
+                                    random.nextFloat() * 2.0f - 1.0f);
+        }
+
+        WavetableRenderPool pool(3);
+        pool.prepare(shared, blockSize);
+
+        std::vector<float> expectedLeft((size_t)blockSize), expectedRight((size_t)blockSize);
+        std::vector<float> actualLeft((size_t)blockSize), actualRight((size_t)blockSize);
+
+        for (auto block = 0; block < 20; ++block)
+        {
+            for (auto *buffer : {&expectedLeft, &expectedRight, &actualLeft, &actualRight})
+                std::fill(buffer->begin(), buffer->end(), 0.0f);
+
+            single.renderNextBlock(expectedLeft.data(), expectedRight.data(), blockSize);
+            pool.render(shared, actualLeft.data(), actualRight.data(), blockSize);
+
+            for (auto sample = 0; sample < blockSize; ++sample)
+            {
+                ASSERT_NEAR(expectedLeft[(size_t)sample], actualLeft[(size_t)sample], 1.0e-5f);
+                ASSERT_NEAR(expectedRight[(size_t)sample], actualRight[(size_t)sample], 1.0e-5f);
+            }
+        }
+    }
+
+
+    TEST(FixedPointWavetableOscillator, KeepsExactPitchOverLongSessions)
+    {
+        const auto tableSize = 1024;
+        juce::AudioSampleBuffer table(1, tableSize + 1);
+
+        for (auto i = 0; i <= tableSize; ++i)
+            table.setSample(0, i, (float)std::sin(juce::MathConstants<double>::twoPi * i / tableSize));
+
+        // exactly 100 samples per cycle
+        const auto sampleRate = 44100.0f, frequency = 441.0f;
+
+        FixedPointWavetableOscillator oscillator(table);
+        oscillator.setFrequency(frequency, sampleRate);
+
+        // ten minutes of audio
+        const auto numSamples = (juce::int64)sampleRate * 600;
+
+        for (juce::int64 i = 0; i < numSamples; ++i)
+            oscillator.getNextSample();
+
+        for (juce::int64 i = numSamples; i < numSamples + 200; ++i)
+        {
+            auto expected = std::sin(juce::MathConstants<double>::twoPi * (double)(i % 100) / 100.0);
+            ASSERT_NEAR(expected, oscillator.getNextSample(), 2.0e-3);
+        }
+    }
+
+    template <typename InterpolatorType>
+    static double getMaxSineError(const MipmappedWavetable &table)
+    {
+        const auto sampleRate = 48000.0f, frequency = 1000.0f;
+
+        BasicWavetableOscillatorBank<InterpolatorType> bank;
+        bank.prepare(1, 512);
+        bank.setWavetable(table);
+        bank.addOscillator(frequency, sampleRate, 1.0f);
+
+        std::vector<float> output(512, 0.0f), right(512, 0.0f);
+        bank.renderNextBlock(output.data(), right.data(), (int)output.size());
+
+        auto maxError = 0.0;
+
+        for (size_t i = 0; i < output.size(); ++i)
+        {
+            auto expected = std::sin(juce::MathConstants<double>::twoPi * frequency * (double)i / sampleRate);
+            maxError = std::max(maxError, std::abs(expected - output[i]));
+        }
+
+        return maxError;
+    }
+
+    TEST(WavetableInterpolation, HigherOrderKernelsBeatLinearOnSmallTables)
+    {
+        juce::AudioSampleBuffer sine(1, 129);
+
+        for (auto i = 0; i <= 128; ++i)
+            sine.setSample(0, i, (float)std::sin(juce::MathConstants<double>::twoPi * i / 128));
+
+        MipmappedWavetable table;
+        table.buildWithBaseSize(sine, 128, 1);
+
+        auto linearError = getMaxSineError<LinearInterpolation>(table);
+        EXPECT_LT(linearError, 1.0e-3);
+
+        // the guard samples let the wider kernels read across the ends of the cycle
+        EXPECT_LT(getMaxSineError<HermiteInterpolation>(table), linearError * 0.25);
+        EXPECT_LT(getMaxSineError<LagrangeInterpolation>(table), linearError * 0.25);
+        EXPECT_LT(getMaxSineError<WindowedSincInterpolation>(table), linearError * 0.25);
+    }
+
+    TEST(HarmonicSpectrum, SingleCycleMatchesSumOfSines)
+    {
+        HarmonicSpectrum spectrum;
+        spectrum.add(1, 0.5f);
+        spectrum.add(3, 0.1f, 1.0f);
+        spectrum.add(7, 0.05f, -2.0f);
+
+        const auto tableSize = 256;
+        auto table = spectrum.createSingleCycle(tableSize);
+        ASSERT_EQ(tableSize + 1, table.getNumSamples());
+
+        for (auto i = 0; i <= tableSize; ++i)
+        {
+            auto angle = juce::MathConstants<double>::twoPi * i / tableSize;
+            auto expected = 0.5 * std::sin(angle) + 0.1 * std::sin(3.0 * angle + 1.0) + 0.05 * std::sin(7.0 * angle - 2.0);
+            ASSERT_NEAR(expected, table.getSample(0, i), 1.0e-5);
+        }
+
+        // building the mipmaps straight from the spectrum gives the same levels
+        MipmappedWavetable fromTable, fromSpectrum;
+        fromTable.build(table, 16 * 1024);
+        fromSpectrum.buildFromSpectrum(spectrum, 16 * 1024);
+
+        ASSERT_EQ(fromTable.getMemoryUsage(), fromSpectrum.getMemoryUsage());
+
+        for (size_t i = 0; i < fromTable.getMemoryUsage() / sizeof(float); ++i)
+            ASSERT_NEAR(fromTable.getData()[i], fromSpectrum.getData()[i], 1.0e-5);
+    }
+
+    TEST(WavetableCache, SharesTablesForEqualSpectra)
+    {
+        HarmonicSpectrum first, same, other;
+        first.add(1, 0.5f);
+        same.add(1, 0.5f);
+        other.add(1, 0.25f);
+
+        EXPECT_EQ(first.getHash(), same.getHash());
+        EXPECT_NE(first.getHash(), other.getHash());
+
+        WavetableCache cache;
+        auto table = cache.getOrBuild(first, 8 * 1024);
+
+        EXPECT_EQ(table, cache.getOrBuild(same, 8 * 1024));
+        EXPECT_NE(table, cache.getOrBuild(other, 8 * 1024));
+        EXPECT_NE(table, cache.getOrBuild(first, 16 * 1024));
+        EXPECT_EQ(3, cache.size());
+
+        // the tables outlive the cache entry while someone still holds them
+        cache.clear();
+        EXPECT_EQ(0, cache.size());
+        EXPECT_GT(table->getNumLevels(), 0);
+    }
+
+    TEST(BlockSineGenerator, KernelStaysWithinItsErrorBound)
+    {
+        auto maxError = 0.0;
+
+        for (auto i = 0; i <= 1 << 22; ++i)
+        {
+            auto x = (float)i / (float)(1 << 22);
+            auto error = std::abs(BlockSineGenerator::sinOfCycles(x) - std::sin(juce::MathConstants<double>::twoPi * x));
+            maxError = std::max(maxError, error);
+        }
+
+        EXPECT_LT(maxError, BlockSineGenerator::maxKernelError);
+    }
+
+    TEST(BlockSineGenerator, BlocksStayWithinTheErrorBoundOfTheIdealPhase)
+    {
+        const auto sampleRate = 44100.0;
+
+        for (auto frequency : {1.0, 27.5, 440.0, 4186.0, 19000.0})
+        {
+            BlockSineGenerator sine;
+            sine.setFrequency(frequency, sampleRate);
+            sine.setPhase(0.1);
+
+            // odd block sizes exercise the scalar tail and the lane re-anchoring
+            std::vector<float> block(1000);
+            juce::int64 position = 0;
+            auto maxError = 0.0;
+
+            for (auto numSamples : {1000, 1, 37, 256, 999, 3, 512, 1000})
+            {
+                for (auto repeat = 0; repeat < 20; ++repeat)
+                {
+                    sine.generate(block.data(), numSamples);
+
+                    for (auto i = 0; i < numSamples; ++i, ++position)
+                    {
+                        auto cycles = std::fmod(0.1 + (long double)position * frequency / sampleRate, 1.0L);
+                        auto expected = std::sin(juce::MathConstants<double>::twoPi * (double)cycles);
+                        maxError = std::max(maxError, std::abs(block[(size_t)i] - expected));
+                    }
+                }
+            }
+
+            EXPECT_LT(maxError, BlockSineGenerator::maxError);
+        }
+    }
+
+    TEST(AdsrEnvelope, StagesLastExactlyTheirLengthWhateverTheBlockSize)
+    {
+        // attack 100, decay 200 and release 300 samples at 1 kHz
+        const AdsrEnvelope::Parameters parameters { 0.1f, 0.2f, 0.5f, 0.3f };
+
+        auto render = [&] (int blockSize)
+        {
+            AdsrEnvelope envelope;
+            envelope.setSampleRate (1000.0);
+            envelope.setParameters (parameters);
+            envelope.noteOn();
+
+            std::vector<float> gains (1000);
+            auto numActive = 0;
+
+            for (auto start = 0; start < 1000; start += blockSize)
+            {
+                if (start == 500)
+                    envelope.noteOff();
+
+                numActive += envelope.process (gains.data() + start, juce::jmin (blockSize, 1000 - start));
+            }
+
+            EXPECT_FALSE(envelope.isActive());
+            EXPECT_EQ(numActive, 800);
+            return gains;
+        };
+
+        auto gains = render (500);
+
+        EXPECT_FLOAT_EQ(gains[0], 0.0f);
+        EXPECT_FLOAT_EQ(gains[50], 0.5f);
+        EXPECT_FLOAT_EQ(gains[100], 1.0f);
+        EXPECT_NEAR(gains[299], 0.5f, 0.5f * AdsrEnvelope::tailRatio * 1.1f);
+        EXPECT_FLOAT_EQ(gains[300], 0.5f);
+        EXPECT_FLOAT_EQ(gains[500], 0.5f);
+        EXPECT_NEAR(gains[799], 0.0f, 0.5f * AdsrEnvelope::tailRatio * 1.1f);
+        EXPECT_EQ(gains[800], 0.0f);
+
+        // blocks that cross the stage boundaries but still start one at the note off
+        for (auto blockSize : { 1, 4, 125, 250 })
+        {
+            auto other = render (blockSize);
+
+            for (size_t i = 0; i < gains.size(); ++i)
+                ASSERT_FLOAT_EQ(other[i], gains[i]);
+        }
+    }
+
+    TEST(AdsrEnvelope, RetriggerClimbsFromTheCurrentLevel)
+    {
+        AdsrEnvelope envelope;
+        envelope.setSampleRate (1000.0);
+        envelope.setParameters ({ 0.1f, 0.1f, 1.0f, 0.1f });
+
+        std::vector<float> gains (400);
+        envelope.noteOn();
+        envelope.process (gains.data(), 150);
+        envelope.noteOff();
+        envelope.process (gains.data() + 150, 50);
+
+        // half way through the release, retrigger
+        auto released = envelope.getLevel();
+        EXPECT_LT(released, 0.1f);
+        envelope.noteOn();
+        envelope.process (gains.data() + 200, 200);
+
+        // no jump: the attack carries on from the release at its usual slope
+        EXPECT_FLOAT_EQ(gains[200], released);
+        EXPECT_LT(gains[199] - gains[200], 0.01f);
+        EXPECT_NEAR(gains[201] - gains[200], 0.01f, 1.0e-5f);
+
+        auto climb = juce::roundToInt((1.0f - released) * 100.0f);
+        EXPECT_LT(gains[(size_t)(199 + climb)], 1.0f);
+        EXPECT_FLOAT_EQ(gains[(size_t)(200 + climb)], 1.0f);
+        EXPECT_FLOAT_EQ(gains[399], 1.0f);
+        EXPECT_TRUE(envelope.isActive());
+    }
+
+    TEST(ActiveVoiceList, TracksAddsAndRemovesInAnyOrder)
+    {
+        ActiveVoiceList list;
+        list.prepare(20);
+
+        juce::Random random(3);
+        std::set<int> expected;
+
+        for (auto step = 0; step < 2000; ++step)
+        {
+            auto voice = random.nextInt(20);
+
+            if (random.nextBool())
+            {
+                list.add(voice);
+                expected.insert(voice);
+            }
+            else
+            {
+                list.remove(voice);
+                expected.erase(voice);
+            }
+
+            ASSERT_EQ(list.size(), (int)expected.size());
+
+            std::set<int> listed;
+
+            for (auto i = 0; i < list.size(); ++i)
+                listed.insert(list[i]);
+
+            ASSERT_TRUE(listed == expected);
+
+            for (auto v = 0; v < 20; ++v)
+                ASSERT_EQ(list.contains(v), expected.count(v) == 1);
+        }
+    }
+
+    TEST(VoiceAllocator, ReleasesTheVoiceEachPolicyPicks)
+    {
+        VoiceAllocator allocator;
+        allocator.prepare(6, 4);
+
+        std::vector<int> voices;
+
+        for (auto note = 60; note < 64; ++note)
+        {
+            auto allocation = allocator.allocate(1, note);
+            EXPECT_EQ(allocation.voiceToRelease, VoiceAllocator::noVoice);
+            voices.push_back(allocation.voice);
+        }
+
+        EXPECT_EQ(std::set<int>(voices.begin(), voices.end()).size(), 4u);
+
+        // over the polyphony the oldest note makes way and tails off on its voice
+        auto allocation = allocator.allocate(1, 64);
+        EXPECT_EQ(allocation.voiceToRelease, voices[0]);
+        EXPECT_TRUE(allocator.isReleased(voices[0]));
+        EXPECT_EQ(allocator.getNumHeld(), 4);
+        EXPECT_EQ(allocator.getNumFree(), 1);
+
+        allocator.setStealingPolicy(VoiceAllocator::StealingPolicy::quietest);
+
+        for (auto i = 1; i < 4; ++i)
+            allocator.setLevel(voices[(size_t)i], i == 2 ? 0.01f : 0.5f);
+
+        allocator.setLevel(allocation.voice, 0.5f);
+
+        auto quietest = allocator.allocate(1, 65);
+        EXPECT_EQ(quietest.voiceToRelease, voices[2]);
+        EXPECT_EQ(allocator.getNumFree(), 0);
+
+        // with nothing free the oldest released voice is cut, never a held one
+        allocator.setStealingPolicy(VoiceAllocator::StealingPolicy::oldest);
+        auto cut = allocator.allocate(1, 66);
+        EXPECT_EQ(cut.voiceToRelease, voices[1]);
+        EXPECT_EQ(cut.voice, voices[0]);
+        EXPECT_EQ(allocator.getNumHeld(), 4);
+
+        // a repeated note starts over on its own voice
+        allocator.setStealingPolicy(VoiceAllocator::StealingPolicy::sameNote);
+        auto repeated = allocator.allocate(1, 66);
+        EXPECT_EQ(repeated.voice, cut.voice);
+        EXPECT_EQ(repeated.voiceToRelease, VoiceAllocator::noVoice);
+        EXPECT_EQ(allocator.getNumHeld(), 4);
+    }
+
+    TEST(VoiceAllocator, KeepsItsListsConsistentUnderRandomNotes)
+    {
+        const auto numVoices = 32, polyphony = 24;
+
+        VoiceAllocator allocator;
+        allocator.prepare(numVoices, polyphony);
+
+        juce::Random random(5);
+
+        for (auto step = 0; step < 20000; ++step)
+        {
+            allocator.setStealingPolicy((VoiceAllocator::StealingPolicy)random.nextInt(3));
+
+            auto channel = 1 + random.nextInt(2);
+            auto note = 48 + random.nextInt(24);
+            auto voice = random.nextInt(numVoices);
+
+            switch (random.nextInt(4))
+            {
+                case 0:
+                case 1:
+                {
+                    auto allocation = allocator.allocate(channel, note);
+                    ASSERT_NE(allocation.voice, VoiceAllocator::noVoice);
+                    ASSERT_NE(allocation.voice, allocation.voiceToRelease);
+                    ASSERT_TRUE(allocator.isHeld(allocation.voice));
+                    break;
+                }
+                case 2:     allocator.release(voice); break;
+                default:    allocator.free(voice); break;
+            }
+
+            allocator.setLevel(voice, random.nextFloat());
+
+            auto numHeld = 0, numReleased = 0, numFree = 0;
+
+            for (auto v = 0; v < numVoices; ++v)
+            {
+                numHeld += allocator.isHeld(v) ? 1 : 0;
+                numReleased += allocator.isReleased(v) ? 1 : 0;
+                numFree += allocator.isFree(v) ? 1 : 0;
+            }
+
+            ASSERT_EQ(numHeld + numReleased + numFree, numVoices);
+            ASSERT_EQ(allocator.getNumHeld(), numHeld);
+            ASSERT_EQ(allocator.getNumFree(), numFree);
+            ASSERT_LE(numHeld, polyphony);
+            ASSERT_EQ(allocator.getSoundingVoices().size(), numHeld + numReleased);
+
+            // every sounding voice is on exactly its own note's list
+            auto numOnNotes = 0;
+
+            for (auto c = 1; c <= 2; ++c)
+            {
+                for (auto n = 48; n < 72; ++n)
+                {
+                    for (auto v = allocator.getFirstVoiceOnNote(c, n); v != VoiceAllocator::noVoice; v = allocator.getNextVoiceOnNote(v))
+                    {
+                        ASSERT_FALSE(allocator.isFree(v));
+                        ASSERT_EQ(allocator.getChannel(v), c);
+                        ASSERT_EQ(allocator.getNote(v), n);
+                        ++numOnNotes;
+                    }
+                }
+            }
+
+            ASSERT_EQ(numOnNotes, numHeld + numReleased);
+        }
+    }
+
+    struct AnyNoteSound : public juce::SynthesiserSound
+    {
+        bool appliesToNote(int) override { return true; }
+        bool appliesToChannel(int) override { return true; }
+    };
+
+    // the tutorial's sine voice, which tails off over a few blocks
+    struct TailingSineVoice : public juce::SynthesiserVoice
+    {
+        using juce::SynthesiserVoice::renderNextBlock;
+
+        bool canPlaySound(juce::SynthesiserSound *sound) override { return dynamic_cast<AnyNoteSound *>(sound) != nullptr; }
+
+        void startNote(int midiNoteNumber, float velocity, juce::SynthesiserSound *, int) override
+        {
+            currentAngle = 0.0;
+            level = velocity * 0.15;
+            tailOff = 0.0;
+            angleDelta = juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber) / getSampleRate() * juce::MathConstants<double>::twoPi;
+        }
+
+        void stopNote(float, bool allowTailOff) override
+        {
+            if (allowTailOff)
+            {
+                if (tailOff == 0.0)
+                    tailOff = 1.0;
+            }
+            else
+            {
+                clearCurrentNote();
+                angleDelta = 0.0;
+            }
+        }
+
+        void pitchWheelMoved(int) override {}
+        void controllerMoved(int, int) override {}
+
+        void renderNextBlock(juce::AudioBuffer<float> &outputBuffer, int startSample, int numSamples) override
+        {
+            if (angleDelta == 0.0)
+                return;
+
+            for (auto sample = startSample; sample < startSample + numSamples; ++sample)
+            {
+                auto gain = tailOff > 0.0 ? level * tailOff : level;
+                auto currentSample = (float)(std::sin(currentAngle) * gain);
+
+                for (auto channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
+                    outputBuffer.addSample(channel, sample, currentSample);
+
+                currentAngle += angleDelta;
+
+                if (tailOff > 0.0)
+                {
+                    tailOff *= 0.99;
+
+                    if (tailOff <= 0.005)
+                    {
+                        clearCurrentNote();
+                        angleDelta = 0.0;
+                        return;
+                    }
+                }
+            }
+        }
+
+        double currentAngle = 0.0, angleDelta = 0.0, level = 0.0, tailOff = 0.0;
+    };
+
+    TEST(ActiveVoiceSynthesiser, RendersWhatJuceSynthesiserRenders)
+    {
+        const auto numVoices = 32, blockSize = 64;
+
+        juce::Synthesiser reference;
+        ActiveVoiceSynthesiser synth;
+
+        for (auto *s : {&reference, static_cast<juce::Synthesiser *>(&synth)})
+        {
+            for (auto i = 0; i < numVoices; ++i)
+                s->addVoice(new TailingSineVoice());
+
+            s->addSound(new AnyNoteSound());
+            s->setCurrentPlaybackSampleRate(48000.0);
+        }
+
+        // notes on two channels, with both pedals and all-notes-off mixed in
+        juce::Random random(11);
+        juce::MidiBuffer midi;
+        juce::AudioBuffer<float> expected(2, blockSize), output(2, blockSize);
+        auto numPedalChanges = 0, numAllNotesOff = 0;
+        auto peak = 0.0f;
+
+        for (auto block = 0; block < 2000; ++block)
+        {
+            midi.clear();
+
+            for (auto i = random.nextInt(4); --i >= 0;)
+            {
+                auto channel = 1 + random.nextInt(2);
+                auto note = 60 + random.nextInt(8);
+                auto position = random.nextInt(blockSize);
+
+                switch (random.nextInt(12))
+                {
+                    case 0:
+                    case 1:
+                    case 2:
+                    case 3:     midi.addEvent(juce::MidiMessage::noteOn(channel, note, (juce::uint8)(1 + random.nextInt(127))), position); break;
+                    case 4:
+                    case 5:
+                    case 6:
+                    case 7:     midi.addEvent(juce::MidiMessage::noteOff(channel, note), position); break;
+                    case 8:
+                    case 9:     midi.addEvent(juce::MidiMessage::controllerEvent(channel, 64, random.nextBool() ? 127 : 0), position); ++numPedalChanges; break;
+                    case 10:    midi.addEvent(juce::MidiMessage::controllerEvent(channel, 66, random.nextBool() ? 127 : 0), position); ++numPedalChanges; break;
+                    default:
+                        if (random.nextInt(8) == 0)
+                        {
+                            midi.addEvent(juce::MidiMessage::allNotesOff(channel), position);
+                            ++numAllNotesOff;
+                        }
+                        break;
+                }
+            }
+
+            expected.clear();
+            output.clear();
+            reference.renderNextBlock(expected, midi, 0, blockSize);
+            synth.renderNextBlockTimed(output, midi, 0, blockSize);
+
+            // a stolen note may go to a different voice, so keep clear of stealing
+            ASSERT_LT(synth.getStats().numActiveVoices, numVoices);
+
+            for (auto channel = 0; channel < 2; ++channel)
+            {
+                for (auto sample = 0; sample < blockSize; ++sample)
+                {
+                    // the voices are summed in a different order
+                    ASSERT_NEAR(output.getSample(channel, sample), expected.getSample(channel, sample), 1.0e-6f);
+
+                    peak = std::max(peak, std::abs(expected.getSample(channel, sample)));
+                }
+            }
+        }
+
+        EXPECT_GT(peak, 0.1f);
+        EXPECT_GT(numPedalChanges, 100);
+        EXPECT_GT(numAllNotesOff, 5);
+    }
+
+    TEST(PartialBank, MatchesSumOfSinesAndCullsAboveNyquist)
+    {
+        const auto sampleRate = 48000.0;
+        const auto numPartials = 20;
+
+        for (auto fundamental : {110.0, 440.0, 3000.0})
+        {
+            PartialBank bank;
+            bank.prepare(numPartials, 256);
+
+            for (auto partial = 1; partial <= numPartials; ++partial)
+                bank.setAmplitude(partial, 1.0f / (float)partial);
+
+            bank.setFrequency(fundamental, sampleRate);
+
+            auto expectedAudible = juce::jmin(numPartials, (int)std::ceil(sampleRate / 2.0 / fundamental) - 1);
+            EXPECT_EQ(bank.getNumAudiblePartials(), expectedAudible);
+
+            // two seconds, long enough for an unanchored float recurrence to
+            // drift audibly off the exact sines
+            std::vector<float> output(96000, 0.0f);
+
+            for (auto start = 0; start < (int)output.size(); start += 1000)
+                bank.renderNextBlock(output.data() + start, juce::jmin(1000, (int)output.size() - start));
+
+            auto maxError = 0.0;
+
+            for (size_t sample = 0; sample < output.size(); ++sample)
+            {
+                auto expected = 0.0;
+
+                for (auto partial = 1; partial <= expectedAudible; ++partial)
+                {
+                    auto angle = juce::MathConstants<double>::twoPi * fundamental / sampleRate * partial;
+                    expected += std::sin(angle * (double)sample) / partial;
+                }
+
+                maxError = std::max(maxError, std::abs(output[sample] - expected));
+            }
+
+            EXPECT_LT(maxError, 5.0e-5);
+        }
+    }
+
+    TEST(MidiEventQueue, DeliversEveryMessageInOrderAcrossThreads)
+    {
+        MidiEventQueue queue;
+        queue.reset(48000.0);
+
+        const auto numMessages = 5000;
+        std::atomic<bool> producerDone{false};
+
+        std::thread producer([&]
+        {
+            for (auto i = 0; i < numMessages; ++i)
+            {
+                auto message = juce::MidiMessage::noteOn(1, i % 128, (juce::uint8)(1 + i / 128));
+                message.setTimeStamp(juce::Time::getMillisecondCounterHiRes() * 0.001);
+                queue.push(message);
+
+                // stay well inside the ring so that nothing is dropped
+                if (i % 256 == 255)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+
+            producerDone = true;
+        });
+
+        juce::MidiBuffer block;
+        block.ensureSize(MidiEventQueue::getBytesNeededForBuffer(0));
+        auto numReceived = 0;
+
+        for (;;)
+        {
+            auto isLastPass = producerDone.load();
+
+            block.clear();
+            queue.removeNextBlockOfMessages(block, 64);
+
+            auto lastPosition = 0;
+
+            for (const auto metadata : block)
+            {
+                auto message = metadata.getMessage();
+                ASSERT_TRUE(metadata.samplePosition >= lastPosition && metadata.samplePosition < 64);
+                ASSERT_EQ(message.getNoteNumber(), numReceived % 128);
+                ASSERT_EQ((int)message.getVelocity(), 1 + numReceived / 128);
+
+                lastPosition = metadata.samplePosition;
+                ++numReceived;
+            }
+
+            if (isLastPass)
+                break;
+
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+
+        producer.join();
+        EXPECT_EQ(numReceived, numMessages);
+        EXPECT_EQ(queue.getNumDropped(), 0);
+    }
+
+    TEST(MidiEventQueue, DropsMessagesWhenFull)
+    {
+        MidiEventQueue queue;
+        queue.reset(48000.0);
+
+        for (auto i = 0; i < MidiEventQueue::capacity + 10; ++i)
+            queue.push(juce::MidiMessage::noteOn(1, 60, (juce::uint8)100));
+
+        EXPECT_EQ(queue.getNumDropped(), 11);
+
+        juce::MidiBuffer block;
+        queue.removeNextBlockOfMessages(block, 512);
+        EXPECT_EQ(block.getNumEvents(), MidiEventQueue::capacity - 1);
+    }
+
+    TEST(MidiEventQueue, ResetOnlyDiscardsMessagesQueuedBeforeIt)
+    {
+        MidiEventQueue queue;
+        queue.reset(48000.0);
+
+        for (auto i = 0; i < 5; ++i)
+            queue.push(juce::MidiMessage::noteOn(1, 60, (juce::uint8)1));
+
+        // the MIDI input keeps pushing between the reset and the next block
+        queue.reset(96000.0);
+
+        for (auto i = 0; i < 3; ++i)
+            queue.push(juce::MidiMessage::noteOn(1, 60, (juce::uint8)2));
+
+        juce::MidiBuffer block;
+        queue.removeNextBlockOfMessages(block, 512);
+        ASSERT_EQ(block.getNumEvents(), 3);
+
+        for (const auto metadata : block)
+            EXPECT_EQ((int)metadata.getMessage().getVelocity(), 2);
+    }
+
+    TEST(MidiClockMapper, PlacesEventsThroughCallbackJitterAndClockDrift)
+    {
+        // a sound card running 200 ppm slow against the system clock, whose
+        // callbacks arrive up to 1 ms early or late
+        const auto sampleRate = 48000.0;
+        const auto blockSize = 512;
+        const auto trueSecondsPerSample = (1.0 + 2.0e-4) / sampleRate;
+        const auto latency = blockSize / sampleRate + 0.003;
+
+        MidiClockMapper clock;
+        clock.reset(sampleRate);
+        clock.setLatency(latency);
+
+        juce::Random random(5);
+        auto maxError = 0.0, maxRawError = 0.0;
+
+        for (auto block = 0; block < 3000; ++block)
+        {
+            auto blockTime = 100.0 + block * blockSize * trueSecondsPerSample;
+            auto jitter = (random.nextDouble() - 0.5) * 0.002;
+            clock.beginBlock(blockTime + jitter, blockSize);
+
+            // give the loop two seconds to lock
+            if (block < 200)
+                continue;
+
+            for (auto sample = 0; sample < blockSize; sample += 37)
+            {
+                auto timeStamp = blockTime + sample * trueSecondsPerSample - latency;
+                maxError = std::max(maxError, std::abs(clock.getSampleOffset(timeStamp) - sample));
+            }
+
+            maxRawError = std::max(maxRawError, std::abs(jitter) * sampleRate);
+        }
+
+        EXPECT_GT(maxRawError, 20.0);
+        EXPECT_LT(maxError, 12.0);
+        EXPECT_NEAR(clock.getEstimatedSampleRate(), 1.0 / trueSecondsPerSample, 1.0);
+    }
+
+    // convolves noise with a decaying noise response in blocks of random size,
+    // processed in place, and returns the largest difference from direct convolution
+    static double convolveAgainstDirectForm(const ConvolutionPartitioning &partitioning, int irLength,
+                                            juce::Random &random, ConvolutionTailThread *tailThread = nullptr)
+    {
+        std::vector<float> impulseResponse((size_t)irLength);
+
+        for (auto i = 0; i < irLength; ++i)
+            impulseResponse[(size_t)i] = (random.nextFloat() * 2.0f - 1.0f) * std::exp(-4.0f * (float)i / (float)irLength);
+
+        auto response = std::make_shared<const PartitionedImpulseResponse>(impulseResponse.data(), irLength, partitioning);
+
+        for (auto &stage : response->getStages())
+            EXPECT_GE(stage.offset, stage.partitionSize * (stage.isBackground ? 2 : 1));
+
+        PartitionedConvolver convolver;
+        convolver.setImpulseResponse(response, tailThread);
+
+        // this loop runs far faster than real time, so wait for the tail rather than drop it
+        convolver.setNonRealtime(true);
+
+        std::vector<float> input((size_t)(irLength * 2 + 1000)), output(input.size());
+
+        for (auto &sample : input)
+            sample = random.nextFloat() * 2.0f - 1.0f;
+
+        for (size_t start = 0; start < input.size();)
+        {
+            auto numSamples = juce::jmin((size_t)(1 + random.nextInt(300)), input.size() - start);
+            std::copy(input.begin() + (long)start, input.begin() + (long)(start + numSamples), output.begin() + (long)start);
+            convolver.process(output.data() + start, output.data() + start, (int)numSamples);
+            start += numSamples;
+        }
+
+        auto maxError = 0.0;
+
+        for (size_t sample = 0; sample < output.size(); ++sample)
+        {
+            auto expected = 0.0;
+
+            for (size_t tap = 0; tap < impulseResponse.size() && tap <= sample; ++tap)
+                expected += (double)impulseResponse[tap] * input[sample - tap];
+
+            maxError = std::max(maxError, std::abs(output[sample] - expected));
+        }
+
+        return maxError;
+    }
+
+    TEST(PartitionedConvolver, MatchesDirectConvolutionForAnyBlockSize)
+    {
+        juce::Random random(3);
+
+        // lengths that end in the head, on a partition boundary, and part way
+        // through a stage, with maximum partitions that cap the stages early and late
+        for (auto irLength : {10, 64, 300, 5000})
+            for (auto maxPartition : {16, 256, 1024})
+                EXPECT_LT(convolveAgainstDirectForm({16, maxPartition}, irLength, random), 1.0e-4);
+    }
+
+    TEST(PartitionedConvolver, TailThreadMatchesDirectConvolution)
+    {
+        juce::Random random(4);
+        ConvolutionTailThread tailThread;
+
+        // the same background layout on the audio thread and handed to the tail thread
+        for (auto backgroundPartition : {64, 256})
+        {
+            EXPECT_LT(convolveAgainstDirectForm({16, 1024, backgroundPartition}, 5000, random), 1.0e-4);
+            EXPECT_LT(convolveAgainstDirectForm({16, 1024, backgroundPartition}, 5000, random, &tailThread), 1.0e-4);
+        }
+    }
+
+    TEST(PartitionedConvolver, PlaysOnWithoutBlocksTheTailThreadHasNotFinished)
+    {
+        struct StallingClient : public ConvolutionTailThread::Client
+        {
+            void processBackgroundBlocks() noexcept override
+            {
+                while (isStalled.load())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            std::atomic<bool> isStalled{true};
+        };
+
+        std::vector<float> impulseResponse(5000, 0.001f);
+        auto response = std::make_shared<const PartitionedImpulseResponse>(impulseResponse.data(), (int)impulseResponse.size(),
+                                                                           ConvolutionPartitioning{16, 1024, 64});
+        StallingClient staller;
+        ConvolutionTailThread tailThread;
+        PartitionedConvolver convolver;
+        convolver.setImpulseResponse(response, &tailThread);
+
+        // the tail thread gets stuck in the staller on its first pass
+        tailThread.addClient(&staller);
+
+        std::vector<float> block(64, 1.0f);
+
+        for (auto i = 0; i < 200; ++i)
+            convolver.process(block.data(), block.data(), (int)block.size());
+
+        EXPECT_GT(convolver.getNumLateBlocks(), 100);
+
+        staller.isStalled = false;
+        tailThread.removeClient(&staller);
+    }
+
+    static void writeImpulseResponse(const juce::File &file, juce::Random &random)
+    {
+        juce::AudioBuffer<float> impulseResponse(2, 300);
+
+        for (auto channel = 0; channel < impulseResponse.getNumChannels(); ++channel)
+            for (auto i = 0; i < impulseResponse.getNumSamples(); ++i)
+                impulseResponse.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+
+        file.deleteFile();
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(file.createOutputStream().release(), 44100.0, 2, 32, {}, 0));
+        ASSERT_NE(writer, nullptr);
+        writer->writeFromAudioSampleBuffer(impulseResponse, 0, impulseResponse.getNumSamples());
+    }
+
+    TEST(ImpulseResponseCache, SharesResponsesUntilTheLastUserLetsGo)
+    {
+        auto file = juce::File::createTempFile(".wav");
+        juce::Random random(5);
+        writeImpulseResponse(file, random);
+
+        ImpulseResponseCache cache{juce::File()};
+        ConvolutionPartitioning partitioning{16, 256};
+        auto responses = cache.getOrLoad(file, 1024, 44100.0, partitioning);
+
+        ASSERT_EQ(2u, responses.size());
+        EXPECT_EQ(300, responses[0]->getLength());
+        EXPECT_EQ(responses, cache.getOrLoad(file, 1024, 44100.0, partitioning));
+        EXPECT_EQ(1, cache.size());
+
+        // anything that changes the spectra is a separate entry
+        auto resampled = cache.getOrLoad(file, 1024, 48000.0, partitioning);
+        auto truncated = cache.getOrLoad(file, 100, 44100.0, partitioning);
+        EXPECT_NE(responses[0], resampled[0]);
+        EXPECT_EQ(100, truncated[0]->getLength());
+        EXPECT_EQ(3, cache.size());
+
+        // one channel keeps the whole file alive
+        resampled.resize(1);
+        truncated.clear();
+        EXPECT_EQ(2, cache.size());
+        resampled.clear();
+        EXPECT_EQ(1, cache.size());
+
+        // an edited file is read again
+        file.setLastModificationTime(file.getLastModificationTime() + juce::RelativeTime::seconds(10.0));
+        EXPECT_NE(responses[0], cache.getOrLoad(file, 1024, 44100.0, partitioning)[0]);
+
+        responses.clear();
+        EXPECT_EQ(0, cache.size());
+        file.deleteFile();
+    }
+
+    TEST(ImpulseResponseCache, MapsSpectraSavedByAnEarlierLoad)
+    {
+        auto file = juce::File::createTempFile(".wav");
+        auto spectrumDirectory = juce::File::createTempFile("");
+        juce::Random random(6);
+        writeImpulseResponse(file, random);
+
+        ConvolutionPartitioning partitioning{16, 64, 64};
+        auto spectrumFile = ImpulseResponseSpectrumFile::getFileFor(spectrumDirectory,
+                                                                    ImpulseResponseSource::forFile(file, 1024, 48000.0, partitioning));
+
+        auto built = ImpulseResponseCache(spectrumDirectory).getOrLoad(file, 1024, 48000.0, partitioning);
+        ASSERT_EQ(2u, built.size());
+        EXPECT_TRUE(spectrumFile.existsAsFile());
+
+        // another process would find the same spectra without transforming anything
+        auto mapped = ImpulseResponseCache(spectrumDirectory).getOrLoad(file, 1024, 48000.0, partitioning);
+        ASSERT_EQ(2u, mapped.size());
+
+        for (size_t channel = 0; channel < built.size(); ++channel)
+        {
+            ASSERT_EQ(built[channel]->getLength(), mapped[channel]->getLength());
+            ASSERT_EQ(built[channel]->getSpectraSize(), mapped[channel]->getSpectraSize());
+            EXPECT_NE(built[channel]->getSpectra(), mapped[channel]->getSpectra());
+            EXPECT_EQ(0, std::memcmp(built[channel]->getHead(), mapped[channel]->getHead(), 16 * sizeof(float)));
+            EXPECT_EQ(0, std::memcmp(built[channel]->getSpectra(), mapped[channel]->getSpectra(),
+                                     (size_t)built[channel]->getSpectraSize() * sizeof(float)));
+        }
+
+        // an edited WAV replaces the stale spectra
+        writeImpulseResponse(file, random);
+        file.setLastModificationTime(file.getLastModificationTime() + juce::RelativeTime::seconds(10.0));
+
+        auto edited = ImpulseResponseCache(spectrumDirectory).getOrLoad(file, 1024, 48000.0, partitioning);
+        ASSERT_EQ(2u, edited.size());
+        EXPECT_NE(0, std::memcmp(built[0]->getHead(), edited[0]->getHead(), 16 * sizeof(float)));
+        EXPECT_EQ(0, std::memcmp(edited[0]->getHead(),
+                                 ImpulseResponseCache(spectrumDirectory).getOrLoad(file, 1024, 48000.0, partitioning)[0]->getHead(),
+                                 16 * sizeof(float)));
+
+        file.deleteFile();
+        spectrumDirectory.deleteRecursively();
+    }
+
+    TEST(AntialiasedTanh, FollowsTanhAndFoldsBackLessThanIt)
+    {
+        AntialiasedTanh<float> slow;
+
+        // a slowly moving input sees tanh, half a step late
+        slow.processSample(-4.001f);
+
+        for (auto x = -4.0; x < 4.0; x += 1.0e-3)
+            ASSERT_NEAR(std::tanh(x - 0.5e-3), slow.processSample((float)x), 1.0e-5);
+
+        // a heavily driven sine on an exact bin, so its odd harmonics above
+        // Nyquist fold onto bins of their own: anything off the three below
+        // Nyquist has folded back
+        const int numSamples = 4096, bin = 301;
+        std::vector<double> plain(numSamples), antialiased(numSamples);
+        AntialiasedTanh<float> shaper;
+
+        for (auto pass = 0; pass < 2; ++pass)
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                auto x = 30.0 * std::sin(juce::MathConstants<double>::twoPi * bin * i / numSamples);
+                plain[(size_t)i] = std::tanh(x);
+                antialiased[(size_t)i] = shaper.processSample((float)x);
+            }
+
+        auto getFoldedEnergy = [&](const std::vector<double> &samples)
+        {
+            auto total = 0.0;
+
+            for (auto sample : samples)
+                total += sample * sample;
+
+            for (auto harmonic : {bin, 3 * bin, 5 * bin})
+            {
+                std::complex<double> sum;
+
+                for (auto i = 0; i < numSamples; ++i)
+                    sum += samples[(size_t)i] * std::polar(1.0, -juce::MathConstants<double>::twoPi * harmonic * i / numSamples);
+
+                total -= 2.0 * std::norm(sum) / numSamples;
+            }
+
+            return total;
+        };
+
+        EXPECT_LT(getFoldedEnergy(antialiased), 0.25 * getFoldedEnergy(plain));
+
+        // the block path runs in lanes, across blocks that split its chunks unevenly
+        AntialiasedTanh<float> blockShaper;
+        std::vector<float> block(numSamples);
+
+        for (auto pass = 0; pass < 2; ++pass)
+        {
+            for (auto i = 0; i < numSamples; ++i)
+                block[(size_t)i] = (float)(30.0 * std::sin(juce::MathConstants<double>::twoPi * bin * i / numSamples));
+
+            for (auto start = 0, blockSize = 1; start < numSamples; start += blockSize, blockSize = blockSize * 3 % 97 + 1)
+                blockShaper.process(block.data() + start, juce::jmin(blockSize, numSamples - start));
+        }
+
+        for (auto i = 0; i < numSamples; ++i)
+            ASSERT_NEAR(antialiased[(size_t)i], block[(size_t)i], 1.0e-6);
+    }
+
+} // namespace test_plugins
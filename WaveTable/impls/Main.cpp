@@ -8,6 +8,13 @@
 
 #include <JuceHeader.h>
 #include "WavetableSynthTutorial_04.h"
+#include "WavetableOfflineRender.h"
+
+//==============================================================================
+// lets WavetableOfflineRender report allocations made on the audio thread
+ALLOCATION_COUNTER_REPLACE_OPERATOR_NEW
+
+//==============================================================================
 
 class Application    : public juce::JUCEApplication
 {
@@ -20,6 +27,16 @@ public:
 
     void initialise (const juce::String&) override
     {
+        // WaveTable --render [options] renders without a window or an audio device
+        auto args = getCommandLineParameterArray();
+
+        if (args.contains (WavetableOfflineRender::commandOption))
+        {
+            setApplicationReturnValue (WavetableOfflineRender::run ({ getApplicationName(), args }));
+            quit();
+            return;
+        }
+
         mainWindow.reset (new MainWindow ("WavetableSynthTutorial", new MainContentComponent, *this));
     }
 
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+
+//==============================================================================
+/** One sine component of a single-cycle waveform: amplitude * sin (number * angle + phase). */
+struct Harmonic
+{
+    int number;
+    float amplitude;
+    float phase = 0.0f;
+
+    bool operator== (const Harmonic&) const = default;
+};
+
+//==============================================================================
+/**
+    A single-cycle waveform described by its harmonics.
+
+    Tables are synthesised from it with one inverse FFT instead of evaluating
+    std::sin for every harmonic at every sample, and getHash() identifies it
+    in a WavetableCache.
+*/
+class HarmonicSpectrum
+{
+public:
+    HarmonicSpectrum() = default;
+
+    void add (int number, float amplitude, float phase = 0.0f)
+    {
+        jassert (number > 0);
+        harmonics.add ({ number, amplitude, phase });
+    }
+
+    const juce::Array<Harmonic>& getHarmonics() const noexcept     { return harmonics; }
+
+    bool operator== (const HarmonicSpectrum& other) const noexcept
+    {
+        return harmonics.size() == other.harmonics.size()
+                && std::equal (harmonics.begin(), harmonics.end(), other.harmonics.begin());
+    }
+
+    /** A 64-bit FNV-1a hash of the harmonics, in the order they were added. */
+    juce::uint64 getHash() const noexcept
+    {
+        juce::uint64 hash = 14695981039346656037ull;
+
+        auto addWord = [&hash] (juce::uint32 word)
+        {
+            for (auto byte = 0; byte < 4; ++byte, word >>= 8)
+                hash = (hash ^ (word & 0xff)) * 1099511628211ull;
+        };
+
+        for (auto& harmonic : harmonics)
+        {
+            addWord ((juce::uint32) harmonic.number);
+            addWord (std::bit_cast<juce::uint32> (harmonic.amplitude));
+            addWord (std::bit_cast<juce::uint32> (harmonic.phase));
+        }
+
+        return hash;
+    }
+
+    //==============================================================================
+    /** Writes the harmonics up to maxHarmonic into bins laid out for
+        juce::dsp::FFT::performRealOnlyInverseTransform() of the given size,
+        so that the transform produces one cycle at the right amplitudes.
+        The bins must hold 2 * tableSize floats and be cleared beforehand.
+    */
+    void fillBins (float* bins, int tableSize, int maxHarmonic) const noexcept
+    {
+        jassert (maxHarmonic < tableSize / 2);
+
+        // the inverse transform divides by tableSize, and each sine is split
+        // between bin n and its mirror image
+        auto scale = (float) tableSize * 0.5f;
+
+        for (auto& harmonic : harmonics)
+        {
+            if (harmonic.number > maxHarmonic)
+                continue;
+
+            // sin (x + phase) is cos (x + phase - pi/2)
+            auto magnitude = harmonic.amplitude * scale;
+            bins[2 * harmonic.number]     += magnitude * std::sin (harmonic.phase);
+            bins[2 * harmonic.number + 1] -= magnitude * std::cos (harmonic.phase);
+        }
+    }
+
+    /** Returns tableSize samples of one cycle followed by a guard sample, the
+        layout createWavetable() used to build with std::sin. Harmonics that
+        don't fit below Nyquist at this size are left out.
+    */
+    juce::AudioSampleBuffer createSingleCycle (int tableSize) const
+    {
+        jassert (juce::isPowerOfTwo (tableSize) && tableSize >= 4);
+
+        juce::HeapBlock<float> bins ((size_t) tableSize * 2, true);
+        fillBins (bins.get(), tableSize, tableSize / 2 - 1);
+
+        juce::dsp::FFT inverse (juce::findHighestSetBit ((juce::uint32) tableSize));
+        inverse.performRealOnlyInverseTransform (bins.get());
+
+        juce::AudioSampleBuffer table (1, tableSize + 1);
+        table.copyFrom (0, 0, bins.get(), tableSize);
+        table.setSample (0, tableSize, bins[0]);
+        return table;
+    }
+
+private:
+    juce::Array<Harmonic> harmonics;
+};
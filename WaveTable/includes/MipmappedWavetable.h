@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cmath>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+#include "HarmonicSpectrum.h"
+
+//==============================================================================
+/** One octave of a MipmappedWavetable: size samples starting at offset, with
+    MipmappedWavetable::guardSamples copies of the other end of the cycle on
+    either side, so interpolators can read past both ends without wrapping.
+*/
+struct WavetableLevel
+{
+    int offset = 0, size = 0, maxHarmonic = 0;
+};
+
+//==============================================================================
+/**
+    A single-cycle waveform stored as one band-limited table per octave.
+
+    Level k only keeps the harmonics that stay below Nyquist while the table delta,
+    measured against the level 0 table, is at most 2^k. Each level is half as long
+    as the one below it (but never shorter than minimumLevelSize), and all levels
+    live in one contiguous buffer, so an oscillator reaches its level through a
+    plain offset and still only does one interpolation per sample.
+*/
+class MipmappedWavetable
+{
+public:
+    static constexpr int minimumLevelSize = 64;
+    static constexpr int maximumBaseSize  = 1 << 16;
+
+    /** Enough for an eight-point kernel, plus one because the phase wrap lets
+        the read index land on size itself.
+    */
+    static constexpr int guardSamples = 5;
+
+    MipmappedWavetable() = default;
+
+    //==============================================================================
+    /** Builds the levels from a single-cycle table laid out the way createWavetable()
+        makes it: a power-of-two number of samples plus one guard sample.
+
+        The level 0 table gets the largest power-of-two size for which all levels
+        together fit into memoryBudgetBytes.
+    */
+    void build (const juce::AudioSampleBuffer& singleCycle, size_t memoryBudgetBytes)
+    {
+        buildWithBaseSize (singleCycle, chooseBaseSize (memoryBudgetBytes));
+    }
+
+    /** Builds the levels with a given power-of-two level 0 size. If maxNumLevels is
+        positive, only that many of the lowest levels are built.
+    */
+    void buildWithBaseSize (const juce::AudioSampleBuffer& singleCycle, int levelZeroSize, int maxNumLevels = 0)
+    {
+        jassert (singleCycle.getNumChannels() == 1);
+        jassert (juce::isPowerOfTwo (levelZeroSize) && levelZeroSize >= minimumLevelSize);
+
+        auto sourceSize = singleCycle.getNumSamples() - 1;
+        jassert (juce::isPowerOfTwo (sourceSize));
+
+        juce::HeapBlock<float> sourceSpectrum ((size_t) sourceSize * 2, true);
+        juce::FloatVectorOperations::copy (sourceSpectrum.get(), singleCycle.getReadPointer (0), sourceSize);
+
+        juce::dsp::FFT forward (getOrder (sourceSize));
+        forward.performRealOnlyForwardTransform (sourceSpectrum.get(), true);
+
+        baseSize = levelZeroSize;
+        layoutLevels (maxNumLevels > 0 ? juce::jmin (maxNumLevels, getNumLevels (baseSize)) : getNumLevels (baseSize));
+
+        for (auto& level : levels)
+        {
+            // the source bins hold sourceSize / 2 times the amplitude of each harmonic,
+            // the inverse transform divides by level.size
+            auto scale = (float) level.size / (float) sourceSize;
+            auto numHarmonics = juce::jmin (level.maxHarmonic, sourceSize / 2 - 1);
+
+            juce::HeapBlock<float> bins ((size_t) level.size * 2, true);
+
+            for (auto bin = 0; bin <= numHarmonics; ++bin)
+            {
+                bins[(size_t) (2 * bin)]     = sourceSpectrum[(size_t) (2 * bin)]     * scale;
+                bins[(size_t) (2 * bin + 1)] = sourceSpectrum[(size_t) (2 * bin + 1)] * scale;
+            }
+
+            writeLevel (level, bins.get());
+        }
+    }
+
+    /** Builds the levels straight from the harmonics, so no single-cycle table or
+        forward transform is needed: each level is one inverse FFT of the
+        harmonics it keeps. The level 0 size is chosen as in build().
+    */
+    void buildFromSpectrum (const HarmonicSpectrum& spectrum, size_t memoryBudgetBytes)
+    {
+        baseSize = chooseBaseSize (memoryBudgetBytes);
+        layoutLevels (getNumLevels (baseSize));
+
+        for (auto& level : levels)
+        {
+            juce::HeapBlock<float> bins ((size_t) level.size * 2, true);
+            spectrum.fillBins (bins.get(), level.size, level.maxHarmonic);
+
+            writeLevel (level, bins.get());
+        }
+    }
+
+    //==============================================================================
+    /** Returns the level to play for a table delta measured against the level 0 table. */
+    static int getLevelForDelta (float baseDelta, int numLevels) noexcept
+    {
+        if (baseDelta <= 1.0f)
+            return 0;
+
+        return juce::jmin ((int) std::ceil (std::log2 (baseDelta)), numLevels - 1);
+    }
+
+    int getLevelForDelta (float baseDelta) const noexcept       { return getLevelForDelta (baseDelta, levels.size()); }
+
+    const float* getData() const noexcept                       { return tables.getReadPointer (0); }
+    const juce::Array<WavetableLevel>& getLevels() const noexcept { return levels; }
+    int getNumLevels() const noexcept                           { return levels.size(); }
+    int getBaseSize() const noexcept                            { return baseSize; }
+    size_t getMemoryUsage() const noexcept                      { return (size_t) tables.getNumSamples() * sizeof (float); }
+
+    /** The number of bytes that build() needs for a given level 0 table size. */
+    static size_t getMemoryNeeded (int levelZeroSize) noexcept
+    {
+        size_t numSamples = 0;
+
+        for (auto level = 0; level < getNumLevels (levelZeroSize); ++level)
+            numSamples += (size_t) (getLevelSize (levelZeroSize, level) + 2 * guardSamples);
+
+        return numSamples * sizeof (float);
+    }
+
+private:
+    //==============================================================================
+    static int getOrder (int size) noexcept                     { return juce::findHighestSetBit ((juce::uint32) size); }
+
+    // stop once a level could only hold the fundamental
+    static int getNumLevels (int levelZeroSize) noexcept        { return juce::jmax (1, getOrder (levelZeroSize) - 1); }
+
+    static int getLevelSize (int levelZeroSize, int level) noexcept
+    {
+        return juce::jmax (levelZeroSize >> level, juce::jmin (minimumLevelSize, levelZeroSize));
+    }
+
+    static int chooseBaseSize (size_t memoryBudgetBytes) noexcept
+    {
+        for (auto size = maximumBaseSize; size > minimumLevelSize; size /= 2)
+            if (getMemoryNeeded (size) <= memoryBudgetBytes)
+                return size;
+
+        jassert (getMemoryNeeded (minimumLevelSize) <= memoryBudgetBytes);
+        return minimumLevelSize;
+    }
+
+    /** Turns the bins into the level's samples and fills in its guard samples. */
+    void writeLevel (const WavetableLevel& level, float* bins)
+    {
+        juce::dsp::FFT inverse (getOrder (level.size));
+        inverse.performRealOnlyInverseTransform (bins);
+
+        auto* samples = tables.getWritePointer (0, level.offset);
+        juce::FloatVectorOperations::copy (samples, bins, level.size);
+
+        for (auto i = 1; i <= guardSamples; ++i)
+            samples[-i] = samples[level.size - i];
+
+        for (auto i = 0; i < guardSamples; ++i)
+            samples[level.size + i] = samples[i];
+    }
+
+    void layoutLevels (int numLevels)
+    {
+        levels.clearQuick();
+        auto numSamples = 0;
+
+        for (auto level = 0; level < numLevels; ++level)
+        {
+            auto size = getLevelSize (baseSize, level);
+            levels.add ({ numSamples + guardSamples, size, juce::jmax (1, (baseSize >> (level + 1)) - 1) });
+            numSamples += size + 2 * guardSamples;
+        }
+
+        tables.setSize (1, numSamples);
+        tables.clear();
+    }
+
+    //==============================================================================
+    juce::AudioSampleBuffer tables;
+    juce::Array<WavetableLevel> levels;
+    int baseSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (MipmappedWavetable)
+};
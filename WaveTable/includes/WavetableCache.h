@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <juce_core/juce_core.h>
+#include "HarmonicSpectrum.h"
+#include "MipmappedWavetable.h"
+
+//==============================================================================
+/**
+    Keeps the MipmappedWavetables built from each HarmonicSpectrum, so that
+    oscillators asking for the same waveform share one set of tables instead of
+    each building their own.
+
+    Entries are found by the spectrum's hash and the memory budget, and the
+    spectrum itself is compared as well, so a hash collision only costs a
+    rebuild. Hold one through a juce::SharedResourcePointer to share it across
+    the whole process. Call it from the message thread or a loader thread, not
+    from the audio thread: a miss builds the tables while holding the lock.
+*/
+class WavetableCache
+{
+public:
+    WavetableCache() = default;
+
+    /** Returns the tables for this spectrum, building them on the first request. */
+    std::shared_ptr<const MipmappedWavetable> getOrBuild (const HarmonicSpectrum& spectrum, size_t memoryBudgetBytes)
+    {
+        auto key = spectrum.getHash() ^ ((juce::uint64) memoryBudgetBytes * 0x9e3779b97f4a7c15ull);
+
+        const juce::ScopedLock sl (lock);
+
+        if (auto found = entries.find (key); found != entries.end())
+            if (found->second.spectrum == spectrum && found->second.memoryBudget == memoryBudgetBytes)
+                return found->second.table;
+
+        auto table = std::make_shared<MipmappedWavetable>();
+        table->buildFromSpectrum (spectrum, memoryBudgetBytes);
+
+        entries.insert_or_assign (key, Entry { spectrum, memoryBudgetBytes, table });
+        return table;
+    }
+
+    int size() const
+    {
+        const juce::ScopedLock sl (lock);
+        return (int) entries.size();
+    }
+
+    /** Forgets every table. Tables still in use stay alive until their last user lets go. */
+    void clear()
+    {
+        const juce::ScopedLock sl (lock);
+        entries.clear();
+    }
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        HarmonicSpectrum spectrum;
+        size_t memoryBudget;
+        std::shared_ptr<const MipmappedWavetable> table;
+    };
+
+    juce::CriticalSection lock;
+    std::unordered_map<juce::uint64, Entry> entries;
+
+    JUCE_DECLARE_NON_COPYABLE (WavetableCache)
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+/**
+    Hands wavetables from the message thread to the audio thread without locks.
+
+    The message thread publish()es a new table; the audio thread calls acquire()
+    once at the start of each block and switches to whatever it returns. Every
+    published table carries a sequence number, and acquire() acknowledges the
+    number of the table the audio thread is now using. A background thread frees
+    the tables that were replaced before the acknowledged one, so the audio
+    thread never locks, allocates or deletes anything. Tables are shared, so one
+    that a WavetableCache also holds lives on after the exchange lets go of it.
+
+    There must be only one audio-thread reader per exchange.
+*/
+template <typename TableType>
+class WavetableExchange  : private juce::Thread
+{
+public:
+    WavetableExchange()
+        : juce::Thread ("Wavetable reclaimer")
+    {
+        startThread();
+    }
+
+    ~WavetableExchange() override
+    {
+        stopThread (1000);
+    }
+
+    //==============================================================================
+    /** Makes a table available to the audio thread. Call this from the message thread. */
+    void publish (std::shared_ptr<const TableType> newTable)
+    {
+        jassert (newTable != nullptr);
+
+        auto* entry = new Entry { std::move (newTable), ++lastSequence };
+
+        {
+            const juce::ScopedLock sl (entryLock);
+            entries.add (entry);
+        }
+
+        published.store (entry, std::memory_order_release);
+        notify();
+    }
+
+    /** Returns the newest published table, or nullptr if there isn't one yet.
+        Call this from the audio thread at a block boundary and use the result
+        for the whole block.
+    */
+    const TableType* acquire() noexcept
+    {
+        auto* entry = published.load (std::memory_order_acquire);
+
+        if (entry == nullptr)
+            return nullptr;
+
+        acknowledged.store (entry->sequence, std::memory_order_release);
+        return entry->table.get();
+    }
+
+    /** The number of tables still alive, including the current one. */
+    int getNumLiveTables() const
+    {
+        const juce::ScopedLock sl (entryLock);
+        return entries.size();
+    }
+
+    /** Frees the tables the audio thread can no longer be using. This is done
+        periodically by the background thread.
+    */
+    void collectGarbage()
+    {
+        auto inUse = acknowledged.load (std::memory_order_acquire);
+        auto* latest = published.load (std::memory_order_acquire);
+
+        const juce::ScopedLock sl (entryLock);
+
+        for (auto i = entries.size(); --i >= 0;)
+        {
+            auto* entry = entries.getUnchecked (i);
+
+            if (entry != latest && entry->sequence < inUse)
+                entries.remove (i);
+        }
+    }
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        std::shared_ptr<const TableType> table;
+        juce::uint64 sequence;
+    };
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            collectGarbage();
+            wait (500);
+        }
+    }
+
+    //==============================================================================
+    juce::CriticalSection entryLock;
+    juce::OwnedArray<Entry> entries;
+    juce::uint64 lastSequence = 0;
+
+    std::atomic<Entry*> published { nullptr };
+    std::atomic<juce::uint64> acknowledged { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (WavetableExchange)
+};
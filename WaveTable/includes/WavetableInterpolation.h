@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <juce_core/juce_core.h>
+#include "FloatLanes.h"
+
+//==============================================================================
+/*
+    Interpolation kernels for wavetable lookups.
+
+    Each kernel reads pointsBefore samples before and pointsAfter samples after
+    the read index, and is written once against the lane interface, so the same
+    code runs on FloatLanes (one oscillator per lane, with gathered reads) and on
+    ScalarLanes. The table must have enough guard samples around the cycle for
+    the kernel's footprint; MipmappedWavetable keeps guardSamples on each side.
+*/
+
+//==============================================================================
+/** Two-point linear interpolation, as WavetableOscillator does it. */
+struct LinearInterpolation
+{
+    static constexpr int pointsBefore = 0, pointsAfter = 1;
+
+    template <typename Lanes>
+    static forcedinline typename Lanes::Float interpolate (const float* table, typename Lanes::Int index,
+                                                           typename Lanes::Float frac) noexcept
+    {
+        auto value0 = Lanes::gather (table, index);
+        auto value1 = Lanes::gather (table + 1, index);
+
+        return Lanes::add (value0, Lanes::mul (frac, Lanes::sub (value1, value0)));
+    }
+};
+
+//==============================================================================
+/** Four-point, third-order Hermite (Catmull-Rom) interpolation. */
+struct HermiteInterpolation
+{
+    static constexpr int pointsBefore = 1, pointsAfter = 2;
+
+    template <typename Lanes>
+    static forcedinline typename Lanes::Float interpolate (const float* table, typename Lanes::Int index,
+                                                           typename Lanes::Float frac) noexcept
+    {
+        auto xm1 = Lanes::gather (table - 1, index);
+        auto x0  = Lanes::gather (table,     index);
+        auto x1  = Lanes::gather (table + 1, index);
+        auto x2  = Lanes::gather (table + 2, index);
+
+        auto half = Lanes::broadcast (0.5f);
+
+        auto c1 = Lanes::mul (half, Lanes::sub (x1, xm1));
+        auto c2 = Lanes::sub (Lanes::add (xm1, Lanes::add (x1, x1)),
+                              Lanes::add (Lanes::mul (Lanes::broadcast (2.5f), x0), Lanes::mul (half, x2)));
+        auto c3 = Lanes::add (Lanes::mul (half, Lanes::sub (x2, xm1)),
+                              Lanes::mul (Lanes::broadcast (1.5f), Lanes::sub (x0, x1)));
+
+        return Lanes::add (Lanes::mul (Lanes::add (Lanes::mul (Lanes::add (Lanes::mul (c3, frac), c2), frac), c1), frac), x0);
+    }
+};
+
+//==============================================================================
+/** Four-point, third-order Lagrange interpolation. */
+struct LagrangeInterpolation
+{
+    static constexpr int pointsBefore = 1, pointsAfter = 2;
+
+    template <typename Lanes>
+    static forcedinline typename Lanes::Float interpolate (const float* table, typename Lanes::Int index,
+                                                           typename Lanes::Float frac) noexcept
+    {
+        auto xm1 = Lanes::gather (table - 1, index);
+        auto x0  = Lanes::gather (table,     index);
+        auto x1  = Lanes::gather (table + 1, index);
+        auto x2  = Lanes::gather (table + 2, index);
+
+        auto one = Lanes::broadcast (1.0f);
+        auto tPlus1  = Lanes::add (frac, one);
+        auto tMinus1 = Lanes::sub (frac, one);
+        auto tMinus2 = Lanes::sub (tMinus1, one);
+
+        auto t0t1 = Lanes::mul (frac, tMinus1);     // t (t - 1)
+        auto t1t2 = Lanes::mul (tMinus1, tMinus2);  // (t - 1) (t - 2)
+
+        // weights with their signs folded in: -1/6, +1/2, -1/2, +1/6
+        auto wm1 = Lanes::mul (Lanes::mul (t0t1, tMinus2), Lanes::broadcast (-1.0f / 6.0f));
+        auto w0  = Lanes::mul (Lanes::mul (t1t2, tPlus1),  Lanes::broadcast (0.5f));
+        auto w1  = Lanes::mul (Lanes::mul (Lanes::mul (tPlus1, frac), tMinus2), Lanes::broadcast (-0.5f));
+        auto w2  = Lanes::mul (Lanes::mul (t0t1, tPlus1),  Lanes::broadcast (1.0f / 6.0f));
+
+        return Lanes::add (Lanes::add (Lanes::mul (wm1, xm1), Lanes::mul (w0, x0)),
+                           Lanes::add (Lanes::mul (w1, x1),   Lanes::mul (w2, x2)));
+    }
+};
+
+//==============================================================================
+/**
+    Eight-point Blackman-windowed sinc interpolation.
+
+    The weights come from a polyphase table with numPhases fractional positions,
+    linearly interpolated between neighbouring phases and normalised to unity
+    gain at DC.
+*/
+struct WindowedSincInterpolation
+{
+    static constexpr int numTaps = 8;
+    static constexpr int pointsBefore = numTaps / 2 - 1, pointsAfter = numTaps / 2;
+    static constexpr int numPhases = 256;
+
+    template <typename Lanes>
+    static forcedinline typename Lanes::Float interpolate (const float* table, typename Lanes::Int index,
+                                                           typename Lanes::Float frac) noexcept
+    {
+        auto scaled = Lanes::mul (frac, Lanes::broadcast ((float) numPhases));
+        auto phase  = Lanes::truncate (scaled);
+        auto phaseFrac = Lanes::sub (scaled, Lanes::toFloat (phase));
+
+        static_assert (numTaps == 8, "the weight offset below is phase * 8");
+        auto weightIndex = Lanes::template shiftLeft<3> (phase);
+
+        auto result = Lanes::broadcast (0.0f);
+
+        for (auto tap = 0; tap < numTaps; ++tap)
+        {
+            auto weight0 = Lanes::gather (weights.data() + tap, weightIndex);
+            auto weight1 = Lanes::gather (weights.data() + numTaps + tap, weightIndex);
+            auto weight  = Lanes::add (weight0, Lanes::mul (phaseFrac, Lanes::sub (weight1, weight0)));
+
+            auto sample = Lanes::gather (table + tap - pointsBefore, index);
+            result = Lanes::add (result, Lanes::mul (weight, sample));
+        }
+
+        return result;
+    }
+
+private:
+    static std::array<float, (numPhases + 1) * numTaps> createWeights() noexcept
+    {
+        std::array<float, (numPhases + 1) * numTaps> rows {};
+        constexpr auto pi = juce::MathConstants<double>::pi;
+        constexpr auto halfWidth = numTaps / 2.0;
+
+        for (auto phase = 0; phase <= numPhases; ++phase)
+        {
+            auto frac = phase / (double) numPhases;
+            double row[numTaps], sum = 0.0;
+
+            for (auto tap = 0; tap < numTaps; ++tap)
+            {
+                auto x = (tap - pointsBefore) - frac;
+                auto sinc = std::abs (x) < 1.0e-9 ? 1.0 : std::sin (pi * x) / (pi * x);
+                auto window = 0.42 + 0.5 * std::cos (pi * x / halfWidth) + 0.08 * std::cos (2.0 * pi * x / halfWidth);
+
+                row[tap] = sinc * window;
+                sum += row[tap];
+            }
+
+            for (auto tap = 0; tap < numTaps; ++tap)
+                rows[(size_t) (phase * numTaps + tap)] = (float) (row[tap] / sum);
+        }
+
+        return rows;
+    }
+
+    /** numPhases + 1 rows of numTaps weights; the last row is the first one shifted by a sample.
+        Built during static initialisation, so the audio thread never builds it.
+    */
+    static inline const std::array<float, (numPhases + 1) * numTaps> weights = createWeights();
+};
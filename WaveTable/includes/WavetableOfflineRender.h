@@ -0,0 +1,88 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include "AllocationCounter.h"
+#include "CommandLineOptions.h"
+#include "OfflineRenderReport.h"
+#include "WavetableSynthTutorial_04.h"
+
+//==============================================================================
+/**
+    Runs WavetableSynthAudioSource without an audio device, as fast as it goes,
+    and reports how long each block took.
+
+    The source is driven through prepareToPlay() and getNextAudioBlock(), just
+    as the device would drive it. Only getNextAudioBlock() is timed, and writing
+    the optional WAV file happens outside that time. The pitches come from a
+    fixed seed, so two runs render the same audio.
+
+    Options: --notes=N (10), --unison=N (1), --detune=cents (25),
+             --spread=percent (100), --block-size=N (512), --seconds=N (10),
+             --sample-rate=N (48000), --output=file.wav (otherwise discarded)
+*/
+struct WavetableOfflineRender
+{
+    static constexpr const char* commandOption = "--render";
+
+    static int run (const juce::ArgumentList& args)
+    {
+        auto numNotes       = CommandLineOptions::getInt (args, "--notes", 10);
+        auto blockSize      = CommandLineOptions::getInt (args, "--block-size", 512);
+        auto seconds        = CommandLineOptions::getInt (args, "--seconds", 10);
+        auto sampleRate     = (double) CommandLineOptions::getInt (args, "--sample-rate", 48000);
+
+        UnisonSettings unison;
+        unison.numVoices    = CommandLineOptions::getInt (args, "--unison", 1);
+        unison.detuneCents  = (float) CommandLineOptions::getInt (args, "--detune", 25, 0);
+        unison.stereoSpread = (float) juce::jmin (100, CommandLineOptions::getInt (args, "--spread", 100, 0)) / 100.0f;
+
+        WavetableSynthAudioSource source (numNotes, unison);
+        source.setRandomSeed (1);
+        source.prepareToPlay (blockSize, sampleRate);
+
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+
+        if (args.containsOption ("--output"))
+        {
+            writer = OfflineRenderReport::createWavWriter (args.getFileForOption ("--output"), sampleRate, 24);
+
+            if (writer == nullptr)
+            {
+                std::cerr << "Couldn't open " << args.getValueForOption ("--output") << " for writing" << std::endl;
+                return 1;
+            }
+        }
+
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        auto numBlocks = (int) std::ceil (seconds * sampleRate / blockSize);
+
+        std::vector<double> blockSeconds;
+        blockSeconds.reserve ((size_t) numBlocks);
+        juce::uint64 numAllocations = 0;
+
+        for (auto block = 0; block < numBlocks; ++block)
+        {
+            juce::AudioSourceChannelInfo bufferToFill (buffer);
+
+            auto allocationsBefore = AllocationCounter::getCount();
+            auto start = juce::Time::getHighResolutionTicks();
+
+            source.getNextAudioBlock (bufferToFill);
+
+            auto end = juce::Time::getHighResolutionTicks();
+            numAllocations += AllocationCounter::getCount() - allocationsBefore;
+            blockSeconds.push_back (juce::Time::highResolutionTicksToSeconds (end - start));
+
+            if (writer != nullptr)
+                writer->writeFromAudioSampleBuffer (buffer, 0, blockSize);
+        }
+
+        source.releaseResources();
+
+        std::cout << source.getNumOscillators() << " oscillators" << std::endl;
+        OfflineRenderReport::print (blockSeconds, numAllocations, blockSize, sampleRate);
+        return 0;
+    }
+};
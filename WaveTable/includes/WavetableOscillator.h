@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cmath>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+//==============================================================================
+/** Where an oscillator is within its table: the sample before the read position
+    and how far the read position is towards the next one.
+*/
+struct WavetablePosition
+{
+    unsigned int index;
+    float fraction;
+};
+
+//==============================================================================
+/**
+    The original phase: a float index into the table, wrapped with a
+    compare-and-subtract. Rounding errors build up in the index, so the pitch
+    slowly drifts over long sessions.
+*/
+class FloatPhase
+{
+public:
+    void setTableSize (int newTableSize) noexcept
+    {
+        if (tableSize > 0 && newTableSize != tableSize)
+        {
+            auto scale = (float) newTableSize / (float) tableSize;
+            currentIndex *= scale;
+            tableDelta *= scale;
+        }
+
+        tableSize = newTableSize;
+    }
+
+    void setFrequency (float frequency, float sampleRate) noexcept
+    {
+        auto tableSizeOverSampleRate = (float) tableSize / sampleRate;
+        tableDelta = frequency * tableSizeOverSampleRate;
+    }
+
+    forcedinline WavetablePosition getPosition() const noexcept
+    {
+        auto index0 = (unsigned int) currentIndex;
+        return { index0, currentIndex - (float) index0 };
+    }
+
+    forcedinline void advance() noexcept
+    {
+        if ((currentIndex += tableDelta) > (float) tableSize)
+            currentIndex -= (float) tableSize;
+    }
+
+private:
+    int tableSize = 0;
+    float currentIndex = 0.0f, tableDelta = 0.0f;
+};
+
+//==============================================================================
+/**
+    A 32-bit fixed-point phase where 2^32 is one cycle, for power-of-two tables.
+
+    The top bits are the table index and the rest are the interpolation weight,
+    so advancing is a single integer add that wraps for free. The increment is
+    quantised once, to 1/2^32 of a cycle, and never accumulates rounding errors,
+    so the pitch stays exact however long the oscillator runs.
+*/
+class FixedPointPhase
+{
+public:
+    void setTableSize (int newTableSize) noexcept
+    {
+        jassert (juce::isPowerOfTwo (newTableSize) && newTableSize > 1);
+
+        // the phase doesn't depend on the table size, so nothing needs rescaling
+        fractionBits = 32 - juce::findHighestSetBit ((juce::uint32) newTableSize);
+        fractionMask = (1u << fractionBits) - 1;
+        fractionScale = 1.0f / (float) (1u << fractionBits);
+    }
+
+    void setFrequency (float frequency, float sampleRate) noexcept
+    {
+        jassert (frequency >= 0.0f && frequency < sampleRate);
+
+        increment = (juce::uint32) std::llround ((double) frequency / (double) sampleRate * 4294967296.0);
+    }
+
+    forcedinline WavetablePosition getPosition() const noexcept
+    {
+        return { phase >> fractionBits, (float) (int) (phase & fractionMask) * fractionScale };
+    }
+
+    forcedinline void advance() noexcept
+    {
+        phase += increment;
+    }
+
+private:
+    juce::uint32 phase = 0, increment = 0, fractionMask = 0;
+    int fractionBits = 31;
+    float fractionScale = 0.0f;
+};
+
+//==============================================================================
+/**
+    Plays a single-cycle table with linear interpolation.
+
+    PhaseType decides how the read position is kept: FloatPhase or FixedPointPhase.
+*/
+template <typename PhaseType>
+class BasicWavetableOscillator
+{
+public:
+    BasicWavetableOscillator (const juce::AudioSampleBuffer& wavetableToUse)
+    {
+        setWavetable (wavetableToUse);
+    }
+
+    /** Switches to another table, keeping the position within the cycle.
+        This doesn't lock or allocate, so it can be called on the audio thread
+        between blocks, e.g. with a table taken from a WavetableExchange.
+    */
+    void setWavetable (const juce::AudioSampleBuffer& wavetableToUse) noexcept
+    {
+        jassert (wavetableToUse.getNumChannels() == 1);
+
+        wavetable = &wavetableToUse;
+        phase.setTableSize (wavetable->getNumSamples() - 1);
+    }
+
+    void setFrequency (float frequency, float sampleRate)
+    {
+        phase.setFrequency (frequency, sampleRate);
+    }
+
+    forcedinline float getNextSample() noexcept
+    {
+        auto position = phase.getPosition();
+
+        auto* table = wavetable->getReadPointer (0);
+        auto value0 = table[position.index];
+        auto value1 = table[position.index + 1];
+
+        auto currentSample = value0 + position.fraction * (value1 - value0);
+
+        phase.advance();
+
+        return currentSample;
+    }
+
+private:
+    const juce::AudioSampleBuffer* wavetable = nullptr;
+    PhaseType phase;
+};
+
+using WavetableOscillator           = BasicWavetableOscillator<FloatPhase>;
+using FixedPointWavetableOscillator = BasicWavetableOscillator<FixedPointPhase>;
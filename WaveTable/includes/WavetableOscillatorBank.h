@@ -0,0 +1,382 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "FloatLanes.h"
+#include "MipmappedWavetable.h"
+#include "WavetableInterpolation.h"
+
+//==============================================================================
+/**
+    Renders many WavetableOscillators at once.
+
+    Instead of one object per oscillator, the phases, deltas and gains live in
+    aligned arrays, and FloatLanes::width oscillators are advanced together in
+    one vector register with gathered table reads. With LinearInterpolation it
+    computes exactly what WavetableOscillator::getNextSample() does per
+    oscillator; only the order in which the oscillators are summed differs.
+
+    The InterpolatorType is one of the kernels in WavetableInterpolation.h. The
+    higher-order ones read samples on both sides of the index, so they need the
+    guard samples of a MipmappedWavetable.
+
+    When playing a MipmappedWavetable, each oscillator is pointed at the level
+    that matches its frequency whenever setFrequency() is called, so the
+    per-sample work stays a single lookup and lerp.
+
+    Every oscillator has its own gain and pan, which are turned into a left and
+    a right gain and applied in the vector registers, so a stereo mix costs one
+    extra multiply-add per sample rather than a second pass over the output.
+    Changes are smoothed with a one-pole ramp (see setSmoothingTime()); groups
+    whose gains have settled skip the ramp entirely.
+
+    setWavetable() neither locks nor allocates, so the audio thread can switch
+    to a table handed over by a WavetableExchange between two blocks.
+*/
+template <typename InterpolatorType>
+class BasicWavetableOscillatorBank
+{
+public:
+    static constexpr int laneWidth = FloatLanes::width;
+
+    static_assert (InterpolatorType::pointsBefore <= MipmappedWavetable::guardSamples
+                    && InterpolatorType::pointsAfter < MipmappedWavetable::guardSamples,
+                   "the interpolator reads further than the mipmap guard samples reach");
+
+    BasicWavetableOscillatorBank() = default;
+
+    //==============================================================================
+    /** Allocates room for the given number of oscillators and removes any existing ones.
+        Blocks longer than maximumBlockSize are rendered in several passes.
+    */
+    void prepare (int maxNumOscillators, int maximumBlockSize)
+    {
+        jassert (maxNumOscillators > 0 && maximumBlockSize > 0);
+
+        capacity = roundUpToLanes (maxNumOscillators);
+        maxBlockSize = maximumBlockSize;
+
+        phases.allocate (capacity);
+        deltas.allocate (capacity);
+        frequencies.allocate (capacity);
+        gains.allocate (capacity);
+        pans .allocate (capacity);
+        targetGains[0].allocate (capacity);
+        targetGains[1].allocate (capacity);
+        currentGains[0].allocate (capacity);
+        currentGains[1].allocate (capacity);
+        limits.allocate (capacity);
+        offsets.allocate (capacity);
+        laneSums.allocate (getScratchSize());
+
+        numOscillators = 0;
+        parkUnusedLanes();
+    }
+
+    /** Plays a single table (with a guard sample) at every pitch. */
+    void setWavetable (const juce::AudioSampleBuffer& wavetableToUse) noexcept
+    {
+        static_assert (InterpolatorType::pointsBefore == 0 && InterpolatorType::pointsAfter <= 1,
+                       "a plain table only has one guard sample at the end; use a MipmappedWavetable");
+        jassert (wavetableToUse.getNumChannels() == 1);
+
+        auto tableSize = wavetableToUse.getNumSamples() - 1;
+        singleLevel = { 0, tableSize, tableSize / 2 - 1 };
+
+        useTable (wavetableToUse.getReadPointer (0), &singleLevel, 1, tableSize);
+    }
+
+    /** Plays the band-limited level of the mipmaps that suits each oscillator's pitch. */
+    void setWavetable (const MipmappedWavetable& mipmaps) noexcept
+    {
+        jassert (mipmaps.getNumLevels() > 0);
+
+        useTable (mipmaps.getData(), mipmaps.getLevels().begin(), mipmaps.getNumLevels(), mipmaps.getBaseSize());
+    }
+
+    //==============================================================================
+    /** Adds an oscillator and returns its index. It starts at its gain and pan
+        straight away, without a ramp.
+    */
+    int addOscillator (float frequency, float sampleRate, float gain, float pan = 0.0f)
+    {
+        jassert (table != nullptr);          // call setWavetable() first
+        jassert (numOscillators < capacity);
+
+        auto index = numOscillators++;
+        phases[index] = 0.0f;
+        limits[index] = 0.0f;
+        setFrequency (index, frequency, sampleRate);
+
+        gains[index] = gain;
+        pans[index] = pan;
+        updateTargetGains (index);
+
+        for (auto channel : { 0, 1 })
+            currentGains[channel][index] = targetGains[channel][index];
+
+        return index;
+    }
+
+    void setFrequency (int index, float frequency, float sampleRate) noexcept
+    {
+        jassert (index < numOscillators);
+
+        frequencies[index] = frequency;
+        currentSampleRate = sampleRate;
+        updateLevel (index);
+    }
+
+    /** Ramps the oscillator's level to the new gain. */
+    void setGain (int index, float gain) noexcept
+    {
+        jassert (index < numOscillators);
+
+        gains[index] = gain;
+        updateTargetGains (index);
+    }
+
+    /** Ramps the oscillator to a new position, from -1 (left) to 1 (right), with
+        the same balanced law as juce::dsp::Panner: the centre leaves both
+        channels at full gain and the far side fades out linearly.
+    */
+    void setPan (int index, float pan) noexcept
+    {
+        jassert (index < numOscillators);
+        jassert (pan >= -1.0f && pan <= 1.0f);
+
+        pans[index] = pan;
+        updateTargetGains (index);
+    }
+
+    /** Sets how quickly gain and pan changes take effect: the time constant of
+        the one-pole ramp. Zero, the default, applies them immediately.
+    */
+    void setSmoothingTime (float seconds, float sampleRate) noexcept
+    {
+        smoothingCoefficient = seconds > 0.0f ? 1.0f - std::exp (-1.0f / (seconds * sampleRate)) : 1.0f;
+    }
+
+    /** Moves the oscillator to a point in its cycle, from 0 up to (but not including) 1. */
+    void setPhase (int index, float cyclePosition) noexcept
+    {
+        jassert (index < numOscillators);
+        jassert (cyclePosition >= 0.0f && cyclePosition < 1.0f);
+
+        phases[index] = cyclePosition * limits[index];
+    }
+
+    float getFrequency (int index) const noexcept   { return frequencies[index]; }
+    float getGain (int index) const noexcept        { return gains[index]; }
+    float getPan (int index) const noexcept         { return pans[index]; }
+
+    int size() const noexcept           { return numOscillators; }
+    int getCapacity() const noexcept    { return capacity; }
+
+    /** The number of laneWidth-sized groups the oscillators are rendered in. */
+    int getNumGroups() const noexcept       { return roundUpToLanes (numOscillators) / laneWidth; }
+
+    /** The number of floats of scratch space that renderGroups() needs. */
+    int getScratchSize() const noexcept     { return 2 * maxBlockSize * laneWidth; }
+
+    //==============================================================================
+    /** Adds the mix of all oscillators, each at its gain and pan, to the two outputs. */
+    void renderNextBlock (float* left, float* right, int numSamples) noexcept
+    {
+        renderGroups (left, right, numSamples, 0, getNumGroups(), laneSums.data());
+    }
+
+    /** Adds the mix of the oscillators in groups [firstGroup, firstGroup + numGroups)
+        to the outputs, using the caller's scratch space (at least getScratchSize()
+        floats, aligned for FloatLanes).
+
+        Different threads may render disjoint ranges of groups at the same time.
+    */
+    void renderGroups (float* left, float* right, int numSamples, int firstGroup, int numGroups, float* scratch) noexcept
+    {
+        jassert (table != nullptr);
+        jassert (firstGroup >= 0 && firstGroup + numGroups <= getNumGroups());
+
+        auto first = firstGroup * laneWidth;
+        auto end = juce::jmin (numOscillators, (firstGroup + numGroups) * laneWidth);
+
+        while (numSamples > 0)
+        {
+            auto numThisTime = juce::jmin (numSamples, maxBlockSize);
+            renderSubBlock (left, right, numThisTime, first, end, scratch);
+
+            left += numThisTime;
+            right += numThisTime;
+            numSamples -= numThisTime;
+        }
+    }
+
+private:
+    //==============================================================================
+    static int roundUpToLanes (int n) noexcept      { return (n + laneWidth - 1) / laneWidth * laneWidth; }
+
+    void useTable (const float* newTable, const WavetableLevel* newLevels, int newNumLevels, int newBaseSize) noexcept
+    {
+        table = newTable;
+        levels = newLevels;
+        numLevels = newNumLevels;
+        baseTableSize = newBaseSize;
+
+        for (auto index = 0; index < numOscillators; ++index)
+            updateLevel (index);
+
+        parkUnusedLanes();
+    }
+
+    /** The spare lanes of the last group are rendered too, so point them at a
+        level whose guard samples cover the interpolator's reach.
+    */
+    void parkUnusedLanes() noexcept
+    {
+        if (levels != nullptr)
+            for (auto index = numOscillators; index < capacity; ++index)
+                offsets[index] = levels[0].offset;
+    }
+
+    void updateLevel (int index) noexcept
+    {
+        auto frequency = frequencies[index];
+        auto baseDelta = frequency * (float) baseTableSize / currentSampleRate;
+        auto& level = levels[MipmappedWavetable::getLevelForDelta (baseDelta, numLevels)];
+
+        auto tableSize = (float) level.size;
+
+        // keep the position within the cycle when moving to a different level or table
+        if (limits[index] > 0.0f && limits[index] != tableSize)
+            phases[index] *= tableSize / limits[index];
+
+        auto tableSizeOverSampleRate = tableSize / currentSampleRate;
+        deltas[index] = frequency * tableSizeOverSampleRate;
+        limits[index] = tableSize;
+        offsets[index] = level.offset;
+    }
+
+    void updateTargetGains (int index) noexcept
+    {
+        auto pan = pans[index];
+        targetGains[0][index] = gains[index] * juce::jmin (1.0f, 1.0f - pan);
+        targetGains[1][index] = gains[index] * juce::jmin (1.0f, 1.0f + pan);
+    }
+
+    bool hasSettled (int first) const noexcept
+    {
+        for (auto channel : { 0, 1 })
+            for (auto i = first; i < first + laneWidth; ++i)
+                if (currentGains[channel][i] != targetGains[channel][i])
+                    return false;
+
+        return true;
+    }
+
+    void renderSubBlock (float* left, float* right, int numSamples, int firstOscillator, int endOscillator, float* scratch) noexcept
+    {
+        auto* leftSums  = scratch;
+        auto* rightSums = scratch + maxBlockSize * laneWidth;
+
+        juce::FloatVectorOperations::clear (leftSums,  numSamples * laneWidth);
+        juce::FloatVectorOperations::clear (rightSums, numSamples * laneWidth);
+
+        // unused lanes in the last group have zero gain, so they add nothing
+        for (auto first = firstOscillator; first < endOscillator; first += laneWidth)
+        {
+            if (hasSettled (first))
+                renderGroup<false> (numSamples, first, leftSums, rightSums);
+            else
+                renderGroup<true> (numSamples, first, leftSums, rightSums);
+        }
+
+        for (auto sample = 0; sample < numSamples; ++sample)
+        {
+            auto* leftSum  = leftSums  + sample * laneWidth;
+            auto* rightSum = rightSums + sample * laneWidth;
+            auto leftTotal = 0.0f, rightTotal = 0.0f;
+
+            for (auto lane = 0; lane < laneWidth; ++lane)
+            {
+                leftTotal  += leftSum[lane];
+                rightTotal += rightSum[lane];
+            }
+
+            left[sample]  += leftTotal;
+            right[sample] += rightTotal;
+        }
+    }
+
+    template <bool isSmoothing>
+    void renderGroup (int numSamples, int first, float* leftSums, float* rightSums) noexcept
+    {
+        auto phase  = FloatLanes::load (phases.data() + first);
+        auto delta  = FloatLanes::load (deltas.data() + first);
+        auto limit  = FloatLanes::load (limits.data() + first);
+        auto offset = FloatLanes::loadInt (offsets.data() + first);
+
+        auto leftGain    = FloatLanes::load (currentGains[0].data() + first);
+        auto rightGain   = FloatLanes::load (currentGains[1].data() + first);
+        auto leftTarget  = FloatLanes::load (targetGains[0].data() + first);
+        auto rightTarget = FloatLanes::load (targetGains[1].data() + first);
+        auto coefficient = FloatLanes::broadcast (smoothingCoefficient);
+
+        for (auto sample = 0; sample < numSamples; ++sample)
+        {
+            auto index0 = FloatLanes::truncate (phase);
+            auto frac   = FloatLanes::sub (phase, FloatLanes::toFloat (index0));
+
+            auto tableIndex = FloatLanes::addInt (index0, offset);
+            auto currentSample = InterpolatorType::template interpolate<FloatLanes> (table, tableIndex, frac);
+
+            if constexpr (isSmoothing)
+            {
+                leftGain  = FloatLanes::add (leftGain,  FloatLanes::mul (coefficient, FloatLanes::sub (leftTarget,  leftGain)));
+                rightGain = FloatLanes::add (rightGain, FloatLanes::mul (coefficient, FloatLanes::sub (rightTarget, rightGain)));
+            }
+
+            auto* leftSum  = leftSums  + sample * laneWidth;
+            auto* rightSum = rightSums + sample * laneWidth;
+            FloatLanes::store (leftSum,  FloatLanes::add (FloatLanes::load (leftSum),  FloatLanes::mul (currentSample, leftGain)));
+            FloatLanes::store (rightSum, FloatLanes::add (FloatLanes::load (rightSum), FloatLanes::mul (currentSample, rightGain)));
+
+            phase = FloatLanes::wrap (FloatLanes::add (phase, delta), limit);
+        }
+
+        FloatLanes::store (phases.data() + first, phase);
+
+        if constexpr (isSmoothing)
+        {
+            FloatLanes::store (currentGains[0].data() + first, leftGain);
+            FloatLanes::store (currentGains[1].data() + first, rightGain);
+
+            // the ramp only approaches its target (and stalls a few ulps short of it
+            // in float), so snap once it is within -80 dB
+            for (auto channel : { 0, 1 })
+            {
+                for (auto i = first; i < first + laneWidth; ++i)
+                {
+                    auto target = targetGains[channel][i];
+
+                    if (std::abs (target - currentGains[channel][i]) <= 1.0e-4f * std::abs (target) + 1.0e-7f)
+                        currentGains[channel][i] = target;
+                }
+            }
+        }
+    }
+
+    //==============================================================================
+    AlignedLaneArray<float> phases, deltas, frequencies, gains, pans, limits, laneSums;
+    AlignedLaneArray<float> targetGains[2], currentGains[2];    // left and right
+    AlignedLaneArray<int32_t> offsets;
+
+    const float* table = nullptr;
+    const WavetableLevel* levels = nullptr;
+    WavetableLevel singleLevel;
+    int numLevels = 0, baseTableSize = 0;
+    float currentSampleRate = 44100.0f, smoothingCoefficient = 1.0f;
+    int numOscillators = 0, capacity = 0, maxBlockSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (BasicWavetableOscillatorBank)
+};
+
+using WavetableOscillatorBank = BasicWavetableOscillatorBank<LinearInterpolation>;
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "WavetableOscillatorBank.h"
+
+//==============================================================================
+/**
+    Spreads the rendering of a BasicWavetableOscillatorBank over pre-spawned
+    real-time worker threads. Banks with any interpolator can be rendered.
+
+    For each block the oscillator groups are split into one chunk per participant.
+    The audio thread renders the first chunk straight into the outputs while every
+    worker renders its chunk into a private stereo buffer, and the partial
+    buffers are then added to the outputs with FloatVectorOperations.
+
+    Workers spin for a little while after each block and then sleep on a futex
+    (std::atomic::wait). The audio thread only issues a wake-up when a worker is
+    actually asleep, and nothing is locked or allocated per callback.
+
+    With no workers, or too few oscillators to be worth splitting, the bank is
+    simply rendered on the calling thread.
+*/
+class WavetableRenderPool
+{
+public:
+    /** Chunks smaller than this aren't worth waking a thread for. */
+    static constexpr int minGroupsPerChunk = 8;
+
+    explicit WavetableRenderPool (int numWorkersToUse)
+    {
+        jassert (numWorkersToUse < (int) participantMask);
+
+        for (auto i = 0; i < numWorkersToUse; ++i)
+            workers.add (new Worker (*this, i + 1));
+
+        for (auto* worker : workers)
+            worker->start();
+    }
+
+    ~WavetableRenderPool()
+    {
+        for (auto* worker : workers)
+            worker->signalThreadShouldExit();
+
+        generation.fetch_add (generationStep);
+        generation.notify_all();
+
+        workers.clear();
+    }
+
+    //==============================================================================
+    /** Allocates the scratch buffers. Call this after preparing the bank. */
+    template <typename BankType>
+    void prepare (const BankType& bank, int maximumBlockSize)
+    {
+        maxBlockSize = maximumBlockSize;
+        callerScratch.allocate (bank.getScratchSize());
+
+        for (auto* worker : workers)
+            worker->prepare (bank.getScratchSize(), maximumBlockSize);
+    }
+
+    int getNumWorkers() const noexcept      { return workers.size(); }
+
+    /** Adds the bank's output to the two output buffers. Call this from the audio thread. */
+    template <typename BankType>
+    void render (BankType& bank, float* left, float* right, int numSamples) noexcept
+    {
+        auto numGroups = bank.getNumGroups();
+        auto numParticipants = juce::jmin (workers.size() + 1, numGroups / minGroupsPerChunk);
+
+        if (numParticipants <= 1)
+        {
+            bank.renderGroups (left, right, numSamples, 0, numGroups, callerScratch.data());
+            return;
+        }
+
+        while (numSamples > 0)
+        {
+            auto numThisTime = juce::jmin (numSamples, maxBlockSize);
+            renderShared (bank, left, right, numThisTime, numParticipants);
+
+            left += numThisTime;
+            right += numThisTime;
+            numSamples -= numThisTime;
+        }
+    }
+
+private:
+    //==============================================================================
+    struct Job
+    {
+        using RenderFunction = void (*) (void* bank, float* left, float* right, int numSamples,
+                                         int firstGroup, int numGroups, float* scratch);
+
+        void* bank = nullptr;
+        RenderFunction renderGroups = nullptr;
+        int numSamples = 0, numGroups = 0, numParticipants = 0;
+
+        int getFirstGroup (int participant) const noexcept  { return participant * numGroups / numParticipants; }
+        int getNumGroups (int participant) const noexcept   { return getFirstGroup (participant + 1) - getFirstGroup (participant); }
+
+        template <typename BankType>
+        static void renderGroupsOf (void* bank, float* left, float* right, int numSamples,
+                                    int firstGroup, int numGroups, float* scratch) noexcept
+        {
+            static_cast<BankType*> (bank)->renderGroups (left, right, numSamples, firstGroup, numGroups, scratch);
+        }
+    };
+
+    static void pause() noexcept
+    {
+       #if defined (__SSE2__) || defined (_M_X64)
+        _mm_pause();
+       #elif defined (__aarch64__)
+        __asm__ __volatile__ ("yield");
+       #else
+        std::this_thread::yield();
+       #endif
+    }
+
+    static constexpr int spinIterations = 4000;
+
+    // the low bits of the generation word carry the number of participants, so a
+    // worker that sits a job out never has to read the Job the audio thread may
+    // already be refilling for the next block
+    static constexpr juce::uint32 participantMask = 0xff, generationStep = participantMask + 1;
+
+    //==============================================================================
+    class Worker  : public juce::Thread
+    {
+    public:
+        Worker (WavetableRenderPool& p, int participantIndex)
+            : juce::Thread ("Wavetable render worker"),
+              pool (p),
+              participant (participantIndex),
+              seen (pool.generation.load())
+        {}
+
+        ~Worker() override
+        {
+            stopThread (1000);
+        }
+
+        void start()
+        {
+            if (! startRealtimeThread ({}))
+                startThread (juce::Thread::Priority::highest);
+        }
+
+        void prepare (int scratchSize, int maximumBlockSize)
+        {
+            laneScratch.allocate (scratchSize);
+            left .allocate (maximumBlockSize);
+            right.allocate (maximumBlockSize);
+        }
+
+        const float* getLeft() const noexcept    { return left.data(); }
+        const float* getRight() const noexcept   { return right.data(); }
+
+    private:
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                seen = waitForNextJob (seen);
+
+                if (threadShouldExit())
+                    break;
+
+                if (participant >= (int) (seen & participantMask))
+                    continue;
+
+                auto& job = pool.job;
+
+                juce::FloatVectorOperations::clear (left.data(),  job.numSamples);
+                juce::FloatVectorOperations::clear (right.data(), job.numSamples);
+                job.renderGroups (job.bank, left.data(), right.data(), job.numSamples,
+                                  job.getFirstGroup (participant), job.getNumGroups (participant),
+                                  laneScratch.data());
+
+                if (pool.remaining.fetch_sub (1, std::memory_order_acq_rel) == 1)
+                    pool.remaining.notify_one();
+            }
+        }
+
+        juce::uint32 waitForNextJob (juce::uint32 seen)
+        {
+            for (auto i = 0; i < spinIterations; ++i)
+            {
+                auto current = pool.generation.load();
+
+                if (current != seen)
+                    return current;
+
+                pause();
+            }
+
+            pool.sleepingWorkers.fetch_add (1);
+
+            auto current = pool.generation.load();
+
+            while (current == seen)
+            {
+                pool.generation.wait (seen);
+                current = pool.generation.load();
+            }
+
+            pool.sleepingWorkers.fetch_sub (1);
+            return current;
+        }
+
+        WavetableRenderPool& pool;
+        const int participant;
+
+        // taken before the thread starts, so that a job posted while it is
+        // still spinning up isn't mistaken for the starting point
+        juce::uint32 seen;
+        AlignedLaneArray<float> laneScratch, left, right;
+
+        JUCE_DECLARE_NON_COPYABLE (Worker)
+    };
+
+    //==============================================================================
+    template <typename BankType>
+    void renderShared (BankType& bank, float* left, float* right, int numSamples, int numParticipants) noexcept
+    {
+        job.bank = &bank;
+        job.renderGroups = Job::template renderGroupsOf<BankType>;
+        job.numSamples = numSamples;
+        job.numGroups = bank.getNumGroups();
+        job.numParticipants = numParticipants;
+
+        remaining.store (numParticipants - 1, std::memory_order_relaxed);
+
+        auto nextGeneration = (generation.load (std::memory_order_relaxed) & ~participantMask) + generationStep;
+        generation.store (nextGeneration | (juce::uint32) numParticipants);
+
+        // a worker that goes to sleep after this check sees the new generation in wait()
+        if (sleepingWorkers.load() > 0)
+            generation.notify_all();
+
+        bank.renderGroups (left, right, numSamples, 0, job.getNumGroups (0), callerScratch.data());
+
+        for (auto i = 0;; ++i)
+        {
+            auto stillRunning = remaining.load (std::memory_order_acquire);
+
+            if (stillRunning == 0)
+                break;
+
+            if (i < spinIterations)
+                pause();
+            else
+                remaining.wait (stillRunning, std::memory_order_acquire);
+        }
+
+        for (auto i = 1; i < numParticipants; ++i)
+        {
+            auto* worker = workers.getUnchecked (i - 1);
+            juce::FloatVectorOperations::add (left,  worker->getLeft(),  numSamples);
+            juce::FloatVectorOperations::add (right, worker->getRight(), numSamples);
+        }
+    }
+
+    //==============================================================================
+    juce::OwnedArray<Worker> workers;
+    AlignedLaneArray<float> callerScratch;
+    int maxBlockSize = 0;
+
+    Job job;
+    std::atomic<juce::uint32> generation { 0 };
+    std::atomic<int> remaining { 0 }, sleepingWorkers { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (WavetableRenderPool)
+};
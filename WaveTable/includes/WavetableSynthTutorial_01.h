@@ -51,6 +51,7 @@
 #include <float.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_audio_basics/juce_audio_basics.h>
+#include "BlockSineGenerator.h"
 
 //==============================================================================
 class SineOscillator
@@ -60,26 +61,45 @@ public:
 
     void setFrequency (float frequency, float sampleRate)
     {
-        auto cyclesPerSample = frequency / sampleRate;
-        angleDelta = cyclesPerSample * juce::MathConstants<float>::twoPi;
+        // carry on from the first sample that hasn't been handed out yet
+        if (nextPending < pending.size())
+            sine.setPhase (pendingStartPhase + (double) nextPending * cyclesPerSample);
+
+        nextPending = pending.size();
+        cyclesPerSample = (double) frequency / sampleRate;
+        sine.setFrequency (frequency, sampleRate);
     }
 
-    forcedinline void updateAngle() noexcept
+    /** Hands out samples from a block rendered ahead, so the kernel still runs
+        several samples at a time.
+    */
+    forcedinline float getNextSample() noexcept
     {
-        currentAngle += angleDelta;
-        if (currentAngle >= juce::MathConstants<float>::twoPi)
-            currentAngle -= juce::MathConstants<float>::twoPi;
+        if (nextPending == pending.size())
+        {
+            pendingStartPhase = sine.getPhase();
+            sine.generate (pending.data(), (int) pending.size());
+            nextPending = 0;
+        }
+
+        return pending[nextPending++];
     }
 
-    forcedinline float getNextSample() noexcept
+    /** Writes the next numSamples samples, several at a time. */
+    void getNextBlock (float* output, int numSamples) noexcept
     {
-        auto currentSample = std::sin (currentAngle);
-        updateAngle();
-        return currentSample;
+        for (; numSamples > 0 && nextPending < pending.size(); --numSamples)
+            *output++ = pending[nextPending++];
+
+        sine.generate (output, numSamples);
     }
 
 private:
-    float currentAngle = 0.0f, angleDelta = 0.0f;
+    BlockSineGenerator sine;
+
+    std::array<float, 64> pending;
+    size_t nextPending = pending.size();
+    double pendingStartPhase = 0.0, cyclesPerSample = 0.0;
 };
 
 //==============================================================================
@@ -116,7 +136,7 @@ public:
         cpuUsageText.setText (juce::String (cpu, 6) + " %", juce::dontSendNotification);
     }
 
-    void prepareToPlay (int, double sampleRate) override
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
     {
         auto numberOfOscillators = 200;                                                 // [1]
 
@@ -132,6 +152,9 @@ public:
         }
 
         level = 0.25f / (float) numberOfOscillators;                                    // [6]
+
+        oscillatorBufferSize = juce::jmax (1, samplesPerBlockExpected);
+        oscillatorBuffer.allocate ((size_t) oscillatorBufferSize, true);
     }
 
     void releaseResources() override {}
@@ -143,16 +166,17 @@ public:
 
         bufferToFill.clearActiveBufferRegion();
 
-        for (auto oscillatorIndex = 0; oscillatorIndex < oscillators.size(); ++oscillatorIndex)
+        for (auto start = 0; start < bufferToFill.numSamples; start += oscillatorBufferSize)
         {
-            auto* oscillator = oscillators.getUnchecked (oscillatorIndex);                      // [8]
+            auto numSamples = juce::jmin (oscillatorBufferSize, bufferToFill.numSamples - start);
 
-            for (auto sample = 0; sample < bufferToFill.numSamples; ++sample)
+            for (auto oscillatorIndex = 0; oscillatorIndex < oscillators.size(); ++oscillatorIndex)
             {
-                auto levelSample = oscillator->getNextSample() * level;                         // [9]
+                auto* oscillator = oscillators.getUnchecked (oscillatorIndex);                  // [8]
+                oscillator->getNextBlock (oscillatorBuffer.get(), numSamples);                  // [9]
 
-                leftBuffer[sample]  += levelSample;                                             // [10]
-                rightBuffer[sample] += levelSample;
+                juce::FloatVectorOperations::addWithMultiply (leftBuffer  + start, oscillatorBuffer.get(), level, numSamples); // [10]
+                juce::FloatVectorOperations::addWithMultiply (rightBuffer + start, oscillatorBuffer.get(), level, numSamples);
             }
         }
     }
@@ -164,5 +188,8 @@ private:
     float level = 0.0f;
     juce::OwnedArray<SineOscillator> oscillators;
 
+    juce::HeapBlock<float> oscillatorBuffer;
+    int oscillatorBufferSize = 0;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainContentComponent)
 };
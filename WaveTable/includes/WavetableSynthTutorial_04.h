@@ -31,7 +31,7 @@
 
  dependencies:     juce_audio_basics, juce_audio_devices, juce_audio_formats,
                    juce_audio_processors, juce_audio_utils, juce_core,
-                   juce_data_structures, juce_events, juce_graphics,
+                   juce_data_structures, juce_dsp, juce_events, juce_graphics,
                    juce_gui_basics, juce_gui_extra
  exporters:        xcode_mac, vs2019, linux_make
 
@@ -50,47 +50,113 @@
 #include <float.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_audio_basics/juce_audio_basics.h>
+#include "WavetableOscillatorBank.h"
+#include "WavetableExchange.h"
+#include "WavetableCache.h"
+#include "WavetableRenderPool.h"
+#include "WavetableUnison.h"
 
 //==============================================================================
-class WavetableOscillator
+/**
+    The synthesiser itself: notes at random pitches, spread across the stereo
+    field, each played by a unison stack of detuned wavetable oscillators.
+
+    It doesn't need an audio device, so the same source can be played by
+    MainContentComponent or driven block by block by WavetableOfflineRender.
+*/
+class WavetableSynthAudioSource   : public juce::AudioSource
 {
 public:
-    WavetableOscillator (const juce::AudioSampleBuffer& wavetableToUse)
-        : wavetable (wavetableToUse),
-          tableSize (wavetable.getNumSamples() - 1)
+    explicit WavetableSynthAudioSource (int numberOfNotesToUse = 10, UnisonSettings unisonToUse = {})
+        : numberOfNotes (numberOfNotesToUse),
+          unison (unisonToUse)
     {
-        jassert (wavetable.getNumChannels() == 1);
+        createWavetable();
+    }
+
+    void createWavetable()
+    {
+        int harmonics[] = { 1, 3, 5, 6, 7, 9, 13, 15 };
+        float harmonicWeights[] = { 0.5f, 0.1f, 0.05f, 0.125f, 0.09f, 0.005f, 0.002f, 0.001f };     // [1]
+
+        jassert (juce::numElementsInArray (harmonics) == juce::numElementsInArray (harmonicWeights));
+
+        HarmonicSpectrum spectrum;
+
+        for (auto harmonic = 0; harmonic < juce::numElementsInArray (harmonics); ++harmonic)
+            spectrum.add (harmonics[harmonic], harmonicWeights[harmonic]);
+
+        // safe while audio is running: the audio thread picks it up at its next block.
+        // Every source playing the same spectrum shares the tables from the cache.
+        wavetables.publish (wavetableCache->getOrBuild (spectrum, wavetableMemoryBudget));
     }
 
-    void setFrequency (float frequency, float sampleRate)
+    /** Makes the random pitches repeatable from one prepareToPlay() to the next. */
+    void setRandomSeed (juce::int64 seed)
     {
-        auto tableSizeOverSampleRate = (float) tableSize / sampleRate;
-        tableDelta = frequency * tableSizeOverSampleRate;
+        random.setSeed (seed);
     }
 
-    forcedinline float getNextSample() noexcept
+    int getNumOscillators() const noexcept      { return numberOfNotes * unison.numVoices; }
+
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
     {
-        auto index0 = (unsigned int) currentIndex;
-        auto index1 = index0 + 1;
+        level = 0.25f / (float) numberOfNotes;
+
+        currentWavetable = wavetables.acquire();
+        jassert (currentWavetable != nullptr);
+
+        oscillators.prepare (getNumOscillators(), samplesPerBlockExpected);
+        oscillators.setWavetable (*currentWavetable);
+        oscillators.setSmoothingTime (gainSmoothingSeconds, (float) sampleRate);
 
-        auto frac = currentIndex - (float) index0;
+        for (auto i = 0; i < numberOfNotes; ++i)
+        {
+            auto midiNote = random.nextDouble() * 36.0 + 48.0;
+            auto frequency = 440.0 * pow (2.0, (midiNote - 69.0) / 12.0);
+            auto pan = random.nextFloat() * 2.0f - 1.0f;
 
-        auto* table = wavetable.getReadPointer (0);
-        auto value0 = table[index0];
-        auto value1 = table[index1];
+            WavetableUnison::addStack (oscillators, (float) frequency, (float) sampleRate, level, pan, unison, random);
+        }
+
+        renderPool.prepare (oscillators, samplesPerBlockExpected);
+    }
+
+    void releaseResources() override {}
+
+    void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override
+    {
+        auto* leftBuffer  = bufferToFill.buffer->getWritePointer (0, bufferToFill.startSample);
+        auto* rightBuffer = bufferToFill.buffer->getWritePointer (1, bufferToFill.startSample);
 
-        auto currentSample = value0 + frac * (value1 - value0);
+        bufferToFill.clearActiveBufferRegion();
 
-        if ((currentIndex += tableDelta) > (float) tableSize)
-            currentIndex -= (float) tableSize;
+        if (auto* latest = wavetables.acquire(); latest != currentWavetable)
+        {
+            currentWavetable = latest;
+            oscillators.setWavetable (*currentWavetable);
+        }
 
-        return currentSample;
+        renderPool.render (oscillators, leftBuffer, rightBuffer, bufferToFill.numSamples);
     }
 
 private:
-    const juce::AudioSampleBuffer& wavetable;
-    const int tableSize;
-    float currentIndex = 0.0f, tableDelta = 0.0f;
+    const size_t wavetableMemoryBudget = 32 * 1024;
+    const float gainSmoothingSeconds = 0.02f;
+    const int numberOfNotes;
+    const UnisonSettings unison;
+    float level = 0.0f;
+
+    juce::Random random;
+    juce::SharedResourcePointer<WavetableCache> wavetableCache;
+    WavetableExchange<MipmappedWavetable> wavetables;
+    const MipmappedWavetable* currentWavetable = nullptr;
+    WavetableOscillatorBank oscillators;
+
+    // only splits the work once there are enough oscillators to make it worthwhile
+    WavetableRenderPool renderPool { juce::jmax (0, juce::SystemStats::getNumPhysicalCpus() - 1) };
+
+    JUCE_DECLARE_NON_COPYABLE (WavetableSynthAudioSource)
 };
 
 //==============================================================================
@@ -105,8 +171,6 @@ public:
         addAndMakeVisible (cpuUsageLabel);
         addAndMakeVisible (cpuUsageText);
 
-        createWavetable();
-
         setSize (400, 200);
         setAudioChannels (0, 2); // no inputs, two outputs
         startTimer (50);
@@ -129,84 +193,26 @@ public:
         cpuUsageText.setText (juce::String (cpu, 6) + " %", juce::dontSendNotification);
     }
 
-    void createWavetable()
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
     {
-        sineTable.setSize (1, (int) tableSize + 1);
-        sineTable.clear();
-
-        auto* samples = sineTable.getWritePointer (0);
-
-        int harmonics[] = { 1, 3, 5, 6, 7, 9, 13, 15 };
-        float harmonicWeights[] = { 0.5f, 0.1f, 0.05f, 0.125f, 0.09f, 0.005f, 0.002f, 0.001f };     // [1]
-
-        jassert (juce::numElementsInArray (harmonics) == juce::numElementsInArray (harmonicWeights));
-
-        for (auto harmonic = 0; harmonic < juce::numElementsInArray (harmonics); ++harmonic)
-        {
-            auto angleDelta = juce::MathConstants<double>::twoPi / (double) (tableSize - 1) * harmonics[harmonic]; // [2]
-            auto currentAngle = 0.0;
-
-            for (unsigned int i = 0; i < tableSize; ++i)
-            {
-                auto sample = std::sin (currentAngle);
-                samples[i] += (float) sample * harmonicWeights[harmonic];                           // [3]
-                currentAngle += angleDelta;
-            }
-        }
-
-        samples[tableSize] = samples[0];
+        synthAudioSource.prepareToPlay (samplesPerBlockExpected, sampleRate);
     }
 
-    void prepareToPlay (int, double sampleRate) override
+    void releaseResources() override
     {
-        auto numberOfOscillators = 10;
-
-        for (auto i = 0; i < numberOfOscillators; ++i)
-        {
-            auto* oscillator = new WavetableOscillator (sineTable);
-
-            auto midiNote = juce::Random::getSystemRandom().nextDouble() * 36.0 + 48.0;
-            auto frequency = 440.0 * pow (2.0, (midiNote - 69.0) / 12.0);
-
-            oscillator->setFrequency ((float) frequency, (float) sampleRate);
-            oscillators.add (oscillator);
-        }
-
-        level = 0.25f / (float) numberOfOscillators;
+        synthAudioSource.releaseResources();
     }
 
-    void releaseResources() override {}
-
     void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override
     {
-        auto* leftBuffer  = bufferToFill.buffer->getWritePointer (0, bufferToFill.startSample);
-        auto* rightBuffer = bufferToFill.buffer->getWritePointer (1, bufferToFill.startSample);
-
-        bufferToFill.clearActiveBufferRegion();
-
-        for (auto oscillatorIndex = 0; oscillatorIndex < oscillators.size(); ++oscillatorIndex)
-        {
-            auto* oscillator = oscillators.getUnchecked (oscillatorIndex);
-
-            for (auto sample = 0; sample < bufferToFill.numSamples; ++sample)
-            {
-                auto levelSample = oscillator->getNextSample() * level;
-
-                leftBuffer[sample]  += levelSample;
-                rightBuffer[sample] += levelSample;
-            }
-        }
+        synthAudioSource.getNextAudioBlock (bufferToFill);
     }
 
 private:
     juce::Label cpuUsageLabel;
     juce::Label cpuUsageText;
 
-    const unsigned int tableSize = 1 << 7;
-    float level = 0.0f;
-
-    juce::AudioSampleBuffer sineTable;
-    juce::OwnedArray<WavetableOscillator> oscillators;
+    WavetableSynthAudioSource synthAudioSource;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainContentComponent)
 };
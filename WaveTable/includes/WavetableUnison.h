@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cmath>
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+/** How a note is thickened into a stack of detuned copies. */
+struct UnisonSettings
+{
+    int numVoices = 1;
+    float detuneCents = 0.0f;       // the outermost voices sit this far either side of the note
+    float stereoSpread = 0.0f;      // 0 keeps every voice at the note's pan, 1 spreads them edge to edge
+    bool randomPhase = true;        // free-running supersaw voices never start in phase
+};
+
+//==============================================================================
+/**
+    Adds unison stacks to a BasicWavetableOscillatorBank.
+
+    The voices of a stack are adjacent oscillators in the bank, so they all read
+    the same table and are advanced side by side in the vector lanes, rather than
+    being N independent oscillator objects. Detune and pan are spread evenly
+    across the stack, and each voice is scaled by 1 / sqrt (numVoices) so that a
+    stack of uncorrelated voices is about as loud as a single one.
+*/
+struct WavetableUnison
+{
+    /** Where voice i of numVoices sits in the stack, from -1 to 1. */
+    static float getVoicePosition (int voice, int numVoices) noexcept
+    {
+        return numVoices > 1 ? 2.0f * (float) voice / (float) (numVoices - 1) - 1.0f : 0.0f;
+    }
+
+    /** Adds the stack for one note and returns the index of its first voice. */
+    template <typename BankType>
+    static int addStack (BankType& bank, float frequency, float sampleRate, float gain, float pan,
+                         const UnisonSettings& settings, juce::Random& random)
+    {
+        jassert (settings.numVoices > 0);
+        jassert (bank.size() + settings.numVoices <= bank.getCapacity());
+
+        auto first = bank.size();
+        auto voiceGain = gain / std::sqrt ((float) settings.numVoices);
+
+        for (auto voice = 0; voice < settings.numVoices; ++voice)
+        {
+            auto position = getVoicePosition (voice, settings.numVoices);
+            auto voiceFrequency = frequency * std::exp2 (position * settings.detuneCents / 1200.0f);
+            auto voicePan = juce::jlimit (-1.0f, 1.0f, pan + position * settings.stereoSpread);
+
+            auto index = bank.addOscillator (voiceFrequency, sampleRate, voiceGain, voicePan);
+
+            if (settings.randomPhase)
+                bank.setPhase (index, random.nextFloat());
+        }
+
+        return first;
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+/**
+    The set of voices that are currently sounding, by voice index.
+
+    Adding, removing and looking up a voice are all O(1): the list is a dense
+    array of indices, and every voice remembers where it sits in that array, so
+    removing one moves the last entry into its slot. The order is therefore not
+    the order the voices were added in.
+
+    All the storage is allocated in prepare(), so the list can be changed from
+    the audio thread.
+*/
+class ActiveVoiceList
+{
+public:
+    ActiveVoiceList() = default;
+
+    /** Makes room for voices 0 to numVoices - 1 and empties the list. */
+    void prepare (int numVoices)
+    {
+        jassert (numVoices >= 0);
+
+        capacity = numVoices;
+        voices.malloc ((size_t) juce::jmax (1, numVoices));
+        positions.malloc ((size_t) juce::jmax (1, numVoices));
+        clear();
+    }
+
+    void clear() noexcept
+    {
+        for (auto voice = 0; voice < capacity; ++voice)
+            positions[voice] = notListed;
+
+        numActive = 0;
+    }
+
+    //==============================================================================
+    bool contains (int voice) const noexcept
+    {
+        jassert (juce::isPositiveAndBelow (voice, capacity));
+        return positions[voice] != notListed;
+    }
+
+    void add (int voice) noexcept
+    {
+        if (contains (voice))
+            return;
+
+        positions[voice] = numActive;
+        voices[numActive++] = voice;
+    }
+
+    void remove (int voice) noexcept
+    {
+        if (! contains (voice))
+            return;
+
+        auto position = positions[voice];
+        auto last = voices[--numActive];
+
+        voices[position] = last;
+        positions[last] = position;
+        positions[voice] = notListed;
+    }
+
+    //==============================================================================
+    int size() const noexcept                    { return numActive; }
+    int getCapacity() const noexcept             { return capacity; }
+
+    /** The index of the i-th active voice, for 0 <= i < size(). */
+    int operator[] (int i) const noexcept
+    {
+        jassert (juce::isPositiveAndBelow (i, numActive));
+        return voices[i];
+    }
+
+private:
+    static constexpr int notListed = -1;
+
+    juce::HeapBlock<int> voices, positions;
+    int capacity = 0, numActive = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ActiveVoiceList)
+};
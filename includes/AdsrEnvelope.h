@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+/**
+    An attack-decay-sustain-release envelope that is rendered a block at a time.
+
+    Each stage is a closed-form segment: the attack is a straight line up to 1,
+    and the decay and release are exponentials whose per-sample ratio is worked
+    out in setParameters(). process() fills the gains one segment at a time, so
+    the only branches are at stage boundaries, never per sample.
+
+    Every stage lasts a whole number of samples. The exponential stages stop
+    once they are within tailRatio of their target and then snap to it, so a
+    released note goes idle after exactly its release time. noteOn() and
+    noteOff() act on the next sample process() produces. Retriggering a note
+    that is still sounding ramps up from the current level at the attack rate
+    instead of jumping to zero.
+*/
+class AdsrEnvelope
+{
+public:
+    struct Parameters
+    {
+        float attack  = 0.005f;     // seconds
+        float decay   = 0.1f;       // seconds
+        float sustain = 1.0f;       // level, 0 to 1
+        float release = 0.05f;      // seconds
+    };
+
+    /** How close an exponential stage gets to its target before it snaps to
+        it, as a fraction of the distance it started from (-60 dB).
+    */
+    static constexpr float tailRatio = 1.0e-3f;
+
+    AdsrEnvelope() noexcept
+    {
+        updateCoefficients();
+    }
+
+    //==============================================================================
+    void setSampleRate (double newSampleRate) noexcept
+    {
+        jassert (newSampleRate > 0.0);
+        sampleRate = newSampleRate;
+        updateCoefficients();
+    }
+
+    void setParameters (const Parameters& newParameters) noexcept
+    {
+        jassert (newParameters.sustain >= 0.0f && newParameters.sustain <= 1.0f);
+        parameters = newParameters;
+        updateCoefficients();
+    }
+
+    const Parameters& getParameters() const noexcept    { return parameters; }
+
+    //==============================================================================
+    /** Starts, or restarts, the attack from the current level. */
+    void noteOn() noexcept
+    {
+        enterAttack();
+    }
+
+    /** Starts the release from the current level. */
+    void noteOff() noexcept
+    {
+        if (stage != Stage::idle)
+            enterRelease();
+    }
+
+    /** Silences the envelope straight away. */
+    void reset() noexcept
+    {
+        enterIdle();
+    }
+
+    bool isActive() const noexcept        { return stage != Stage::idle; }
+    float getLevel() const noexcept       { return level; }
+
+    //==============================================================================
+    /** Writes the next numSamples gains.
+
+        Returns how many of them come before the envelope went idle, which is
+        numSamples unless the release finished inside this block. The gains
+        after that point are zero.
+    */
+    int process (float* gains, int numSamples) noexcept
+    {
+        auto numActive = 0;
+
+        while (numSamples > 0)
+        {
+            auto numThisTime = juce::jmin (numSamples, samplesLeftInStage);
+
+            switch (stage)
+            {
+                case Stage::attack:
+                    for (auto i = 0; i < numThisTime; ++i)
+                        gains[i] = attackStart + (float) (attackPosition + i) * attackIncrement;
+
+                    attackPosition += numThisTime;
+                    level = attackStart + (float) attackPosition * attackIncrement;
+                    break;
+
+                case Stage::decay:
+                case Stage::release:
+                {
+                    auto ratio = stage == Stage::decay ? decayRatio : releaseRatio;
+
+                    for (auto i = 0; i < numThisTime; ++i)
+                    {
+                        gains[i] = target + offset;
+                        offset *= ratio;
+                    }
+
+                    level = target + offset;
+                    break;
+                }
+
+                case Stage::sustain:
+                case Stage::idle:
+                    juce::FloatVectorOperations::fill (gains, level, numThisTime);
+                    break;
+            }
+
+            if (stage != Stage::idle)
+                numActive += numThisTime;
+
+            gains += numThisTime;
+            numSamples -= numThisTime;
+            samplesLeftInStage -= numThisTime;
+
+            if (samplesLeftInStage == 0)
+                enterNextStage();
+        }
+
+        return numActive;
+    }
+
+private:
+    //==============================================================================
+    enum class Stage
+    {
+        idle,
+        attack,
+        decay,
+        sustain,
+        release
+    };
+
+    static constexpr int untilNextEvent = std::numeric_limits<int>::max();
+
+    int toSamples (float seconds) const noexcept
+    {
+        return juce::jmax (0, juce::roundToInt (seconds * sampleRate));
+    }
+
+    void updateCoefficients() noexcept
+    {
+        attackSamples  = toSamples (parameters.attack);
+        decaySamples   = toSamples (parameters.decay);
+        releaseSamples = toSamples (parameters.release);
+
+        attackIncrement = attackSamples > 0 ? 1.0f / (float) attackSamples : 1.0f;
+        decayRatio      = decaySamples > 0 ? std::pow (tailRatio, 1.0f / (float) decaySamples) : 0.0f;
+        releaseRatio    = releaseSamples > 0 ? std::pow (tailRatio, 1.0f / (float) releaseSamples) : 0.0f;
+    }
+
+    void enterAttack() noexcept
+    {
+        // a retrigger only climbs the rest of the way, at the same rate
+        stage = Stage::attack;
+        attackStart = level;
+        attackPosition = 0;
+        samplesLeftInStage = juce::roundToInt ((1.0f - level) / attackIncrement);
+
+        if (samplesLeftInStage == 0)
+            enterDecay();
+    }
+
+    void enterDecay() noexcept
+    {
+        level = 1.0f;
+        target = parameters.sustain;
+        offset = level - target;
+        stage = Stage::decay;
+        samplesLeftInStage = decaySamples;
+
+        if (samplesLeftInStage == 0)
+            enterSustain();
+    }
+
+    void enterSustain() noexcept
+    {
+        level = parameters.sustain;
+        stage = Stage::sustain;
+        samplesLeftInStage = untilNextEvent;
+    }
+
+    void enterRelease() noexcept
+    {
+        target = 0.0f;
+        offset = level;
+        stage = Stage::release;
+        samplesLeftInStage = releaseSamples;
+
+        if (samplesLeftInStage == 0)
+            enterIdle();
+    }
+
+    void enterIdle() noexcept
+    {
+        level = 0.0f;
+        stage = Stage::idle;
+        samplesLeftInStage = untilNextEvent;
+    }
+
+    void enterNextStage() noexcept
+    {
+        switch (stage)
+        {
+            case Stage::attack:     enterDecay(); break;
+            case Stage::decay:      enterSustain(); break;
+            case Stage::release:    enterIdle(); break;
+            case Stage::sustain:
+            case Stage::idle:       break;
+        }
+    }
+
+    //==============================================================================
+    Parameters parameters;
+    double sampleRate = 44100.0;
+
+    int attackSamples = 0, decaySamples = 0, releaseSamples = 0;
+    float attackIncrement = 1.0f, decayRatio = 0.0f, releaseRatio = 0.0f;
+
+    Stage stage = Stage::idle;
+    int samplesLeftInStage = untilNextEvent;
+    float level = 0.0f;
+
+    // the attack is a line from attackStart, the other stages an exponential
+    // that shrinks the offset from target; both are independent of how the
+    // stage is split into blocks
+    float attackStart = 0.0f;
+    int attackPosition = 0;
+    float target = 0.0f, offset = 0.0f;
+};
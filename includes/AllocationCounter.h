@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+/**
+    Counts calls to the global operator new, for load tests that check the audio
+    callback doesn't allocate.
+
+    The count only moves in an executable that replaces operator new and
+    delete with ALLOCATION_COUNTER_REPLACE_OPERATOR_NEW. Memory that JUCE gets
+    from malloc directly, such as a HeapBlock, isn't counted.
+*/
+struct AllocationCounter
+{
+    static juce::uint64 getCount() noexcept
+    {
+        return getCounter().load (std::memory_order_relaxed);
+    }
+
+    static void* allocate (size_t size)
+    {
+        getCounter().fetch_add (1, std::memory_order_relaxed);
+
+        if (auto* memory = std::malloc (size != 0 ? size : 1))
+            return memory;
+
+        throw std::bad_alloc();
+    }
+
+    static void release (void* memory) noexcept
+    {
+        std::free (memory);
+    }
+
+private:
+    static std::atomic<juce::uint64>& getCounter() noexcept
+    {
+        static std::atomic<juce::uint64> counter { 0 };
+        return counter;
+    }
+};
+
+//==============================================================================
+/** Replaces the global operator new and delete with ones that go through
+    AllocationCounter. Use it once, at global scope, in one source file of
+    the executable.
+*/
+#define ALLOCATION_COUNTER_REPLACE_OPERATOR_NEW \
+    void* operator new (size_t size)                    { return AllocationCounter::allocate (size); } \
+    void* operator new[] (size_t size)                  { return AllocationCounter::allocate (size); } \
+    void operator delete (void* p) noexcept             { AllocationCounter::release (p); } \
+    void operator delete[] (void* p) noexcept           { AllocationCounter::release (p); } \
+    void operator delete (void* p, size_t) noexcept     { AllocationCounter::release (p); } \
+    void operator delete[] (void* p, size_t) noexcept   { AllocationCounter::release (p); }
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <juce_core/juce_core.h>
+#include "FloatLanes.h"
+
+//==============================================================================
+/**
+    tanh with first-order antiderivative anti-aliasing (ADAA), for one channel.
+
+    Instead of shaping each sample on its own, it returns the mean of tanh
+    along the straight line from the previous input to this one, which is
+    (F (x) - F (xPrevious)) / (x - xPrevious) with F (x) = log (cosh (x)).
+    That acts as a lowpass on the harmonics the curve creates, so much less
+    of them folds back below Nyquist, for the price of half a sample of delay.
+
+    F is written as |x| + R (min (|x|, 9)), where R is a rational fit of
+    log (1 + exp (-2u)) that is within 4e-7 of tanh once differentiated.
+    The |x| part is divided out exactly, and R's part is taken as its divided
+    difference, which is a ratio of polynomials in both inputs. Nothing is
+    subtracted and then divided by a small step, so this stays accurate in
+    float however close two inputs are. Only when they are exactly equal
+    does it fall back to the slope at that point, which is the limit.
+
+    process() runs a block through FloatLanes, with no exp, log or branch
+    per sample. Double samples are shaped in float, which is already more
+    precise than the fit.
+*/
+template <typename SampleType>
+class AntialiasedTanh
+{
+public:
+    AntialiasedTanh() = default;
+
+    void reset() noexcept
+    {
+        previousInput = 0.0f;
+    }
+
+    SampleType processSample (SampleType input) noexcept
+    {
+        auto x = (float) input;
+        auto y = shape<ScalarLanes> (previousInput, x);
+        previousInput = x;
+        return (SampleType) y;
+    }
+
+    void process (SampleType* samples, int numSamples) noexcept
+    {
+        alignas (FloatLanes::alignment) float previous[chunkSize];
+        alignas (FloatLanes::alignment) float current[chunkSize];
+
+        for (auto offset = 0; offset < numSamples; offset += chunkSize)
+        {
+            auto numThisTime = juce::jmin (chunkSize, numSamples - offset);
+            auto numPadded = (numThisTime + FloatLanes::width - 1) / FloatLanes::width * FloatLanes::width;
+
+            for (auto i = 0; i < numThisTime; ++i)
+                current[i] = (float) samples[offset + i];
+
+            previous[0] = previousInput;
+            std::copy (current, current + numThisTime - 1, previous + 1);
+
+            for (auto i = numThisTime; i < numPadded; ++i)
+                previous[i] = current[i] = 0.0f;
+
+            previousInput = current[numThisTime - 1];
+
+            for (auto i = 0; i < numPadded; i += FloatLanes::width)
+                FloatLanes::store (current + i, shape<FloatLanes> (FloatLanes::load (previous + i),
+                                                                   FloatLanes::load (current + i)));
+
+            for (auto i = 0; i < numThisTime; ++i)
+                samples[offset + i] = (SampleType) current[i];
+        }
+    }
+
+private:
+    //==============================================================================
+    /** The mean of tanh between a and b, one pair of inputs per lane. */
+    template <typename Lanes>
+    static forcedinline typename Lanes::Float shape (typename Lanes::Float a, typename Lanes::Float b) noexcept
+    {
+        using Float = typename Lanes::Float;
+
+        auto absA = Lanes::abs (a);
+        auto absB = Lanes::abs (b);
+        auto uA = Lanes::min (absA, Lanes::broadcast (fitLimit));
+        auto uB = Lanes::min (absB, Lanes::broadcast (fitLimit));
+
+        Float pA, pB, pDifference, qA, qB, qDifference;
+        evaluate<Lanes> (numerator, uA, uB, pA, pB, pDifference);
+        evaluate<Lanes> (denominator, uA, uB, qA, qB, qDifference);
+
+        // (R (uB) - R (uA)) / (uB - uA), which is R' (uA) when they are equal
+        auto rSlope = Lanes::div (Lanes::sub (Lanes::mul (pDifference, qA), Lanes::mul (pA, qDifference)),
+                                  Lanes::mul (qA, qB));
+
+        auto smallest = Lanes::broadcast (std::numeric_limits<float>::min());
+        auto dx = Lanes::sub (b, a);
+        auto absDx = Lanes::abs (dx);
+        auto reciprocal = Lanes::div (Lanes::broadcast (1.0f), Lanes::selectBelow (absDx, smallest, Lanes::broadcast (1.0f), dx));
+
+        // With a == b, the slopes of |x| and of min (|x|, 9) at b
+        auto sign = Lanes::div (b, Lanes::add (absB, smallest));
+        auto clampedSign = Lanes::selectBelow (absB, Lanes::broadcast (fitLimit), sign, Lanes::broadcast (0.0f));
+
+        auto absSlope     = Lanes::selectBelow (absDx, smallest, sign,        Lanes::mul (Lanes::sub (absB, absA), reciprocal));
+        auto clampedSlope = Lanes::selectBelow (absDx, smallest, clampedSign, Lanes::mul (Lanes::sub (uB, uA), reciprocal));
+
+        return Lanes::add (absSlope, Lanes::mul (rSlope, clampedSlope));
+    }
+
+    /** A polynomial at a and b by Horner's rule, with the divided difference
+        of the two carried alongside: D = D * b + (the partial value at a).
+    */
+    template <typename Lanes, size_t numCoefficients>
+    static forcedinline void evaluate (const float (&coefficients)[numCoefficients],
+                                       typename Lanes::Float a, typename Lanes::Float b,
+                                       typename Lanes::Float& atA, typename Lanes::Float& atB,
+                                       typename Lanes::Float& difference) noexcept
+    {
+        atA = atB = Lanes::broadcast (coefficients[numCoefficients - 1]);
+        difference = Lanes::broadcast (0.0f);
+
+        for (auto k = (int) numCoefficients - 2; k >= 0; --k)
+        {
+            difference = Lanes::add (Lanes::mul (difference, b), atA);
+            atA = Lanes::add (Lanes::mul (atA, a), Lanes::broadcast (coefficients[k]));
+            atB = Lanes::add (Lanes::mul (atB, b), Lanes::broadcast (coefficients[k]));
+        }
+    }
+
+    //==============================================================================
+    static constexpr int chunkSize = 64;
+
+    /** Above this, log (1 + exp (-2u)) is below 2e-8 and R is held constant. */
+    static constexpr float fitLimit = 9.0f;
+
+    /** R (u) = P (u) / Q (u) ~ log (1 + exp (-2u)) on [0, fitLimit], with
+        R (0) = log (2) and R' (0) = -1 so that F is smooth through zero.
+    */
+    static constexpr float numerator[] = { 0.693147181f, -0.432661739f, 0.111183002f, -0.0146369068f,
+                                           0.000981865145f, -2.66944553e-05f };
+    static constexpr float denominator[] = { 1.0f, 0.818496096f, 0.61991646f, 0.282519864f,
+                                             0.0836672217f, 0.0106985133f, 0.00509343146f };
+
+    float previousInput = 0.0f;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+/**
+    Reads the numeric options of the apps' offline modes and the benchmarks,
+    given as --name=value, so every tool treats a missing or silly value the
+    same way.
+*/
+struct CommandLineOptions
+{
+    /** The option's value, or defaultValue if it isn't given. A value below
+        minimum, including one that doesn't parse, is raised to minimum.
+    */
+    static int getInt (const juce::ArgumentList& args, const juce::String& option, int defaultValue, int minimum = 1)
+    {
+        auto value = args.getValueForOption (option);
+        return value.isEmpty() ? defaultValue : juce::jmax (minimum, value.getIntValue());
+    }
+};
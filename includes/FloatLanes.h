@@ -0,0 +1,290 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <juce_core/juce_core.h>
+
+#if defined (__AVX512F__) || defined (__AVX2__)
+ #include <immintrin.h>
+#elif defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define FLOAT_LANES_SSE2 1
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__)
+ #include <arm_neon.h>
+ #define FLOAT_LANES_NEON 1
+#endif
+
+//==============================================================================
+/**
+    The same operations as FloatLanes on a single value, for code that is written
+    once against the lane interface but also needs a scalar version.
+*/
+struct ScalarLanes
+{
+    static constexpr int width = 1;
+    using Float = float;
+    using Int   = int32_t;
+
+    static forcedinline Float load (const float* p) noexcept               { return *p; }
+    static forcedinline void store (float* p, Float v) noexcept            { *p = v; }
+    static forcedinline void storeUnaligned (float* p, Float v) noexcept   { *p = v; }
+    static forcedinline Int loadInt (const int32_t* p) noexcept            { return *p; }
+    static forcedinline void storeInt (int32_t* p, Int v) noexcept         { *p = v; }
+    static forcedinline Float broadcast (float v) noexcept                 { return v; }
+    static forcedinline Float add (Float a, Float b) noexcept              { return a + b; }
+    static forcedinline Float sub (Float a, Float b) noexcept              { return a - b; }
+    static forcedinline Float mul (Float a, Float b) noexcept              { return a * b; }
+    static forcedinline Int truncate (Float v) noexcept                    { return (Int) v; }
+    static forcedinline Float toFloat (Int v) noexcept                     { return (Float) v; }
+    static forcedinline Int addInt (Int a, Int b) noexcept                 { return a + b; }
+    static forcedinline Int broadcastInt (int32_t v) noexcept              { return v; }
+    static forcedinline Float gather (const float* table, Int i) noexcept  { return table[i]; }
+    template <int bits> static forcedinline Int shiftLeft (Int v) noexcept { return v << bits; }
+    static forcedinline Float wrap (Float phase, Float limit) noexcept     { return phase > limit ? phase - limit : phase; }
+    static forcedinline Float div (Float a, Float b) noexcept              { return a / b; }
+    static forcedinline Float abs (Float v) noexcept                       { return std::abs (v); }
+    static forcedinline Float min (Float a, Float b) noexcept              { return a < b ? a : b; }
+    static forcedinline Float selectBelow (Float v, Float limit, Float ifBelow, Float otherwise) noexcept  { return v < limit ? ifBelow : otherwise; }
+};
+
+//==============================================================================
+/**
+    The handful of float/int32 vector operations that the oscillator banks and
+    AntialiasedTanh need, mapped onto the widest instruction set the compiler
+    was told it can use (AVX-512: 16 lanes, AVX2: 8, SSE2/NEON: 4, otherwise a scalar fallback).
+
+    Only AVX2 and AVX-512 have a hardware gather; the narrower targets assemble
+    the lanes from scalar loads, which is still cheaper than walking objects.
+*/
+struct FloatLanes
+{
+   #if defined (__AVX512F__)
+    static constexpr int width = 16;
+    using Float = __m512;
+    using Int   = __m512i;
+
+    static forcedinline Float load (const float* p) noexcept               { return _mm512_load_ps (p); }
+    static forcedinline void store (float* p, Float v) noexcept            { _mm512_store_ps (p, v); }
+    static forcedinline void storeUnaligned (float* p, Float v) noexcept   { _mm512_storeu_ps (p, v); }
+    static forcedinline Int loadInt (const int32_t* p) noexcept            { return _mm512_load_si512 (p); }
+    static forcedinline void storeInt (int32_t* p, Int v) noexcept         { _mm512_store_si512 (p, v); }
+    static forcedinline Float broadcast (float v) noexcept                 { return _mm512_set1_ps (v); }
+    static forcedinline Float add (Float a, Float b) noexcept              { return _mm512_add_ps (a, b); }
+    static forcedinline Float sub (Float a, Float b) noexcept              { return _mm512_sub_ps (a, b); }
+    static forcedinline Float mul (Float a, Float b) noexcept              { return _mm512_mul_ps (a, b); }
+    static forcedinline Int truncate (Float v) noexcept                    { return _mm512_cvttps_epi32 (v); }
+    static forcedinline Float toFloat (Int v) noexcept                     { return _mm512_cvtepi32_ps (v); }
+    static forcedinline Int addInt (Int a, Int b) noexcept                 { return _mm512_add_epi32 (a, b); }
+    static forcedinline Int broadcastInt (int32_t v) noexcept              { return _mm512_set1_epi32 (v); }
+    static forcedinline Float gather (const float* table, Int i) noexcept  { return _mm512_i32gather_ps (i, table, 4); }
+    template <int bits> static forcedinline Int shiftLeft (Int v) noexcept { return _mm512_slli_epi32 (v, bits); }
+
+    static forcedinline Float wrap (Float phase, Float limit) noexcept
+    {
+        auto above = _mm512_cmp_ps_mask (phase, limit, _CMP_GT_OQ);
+        return _mm512_mask_sub_ps (phase, above, phase, limit);
+    }
+
+    static forcedinline Float div (Float a, Float b) noexcept              { return _mm512_div_ps (a, b); }
+    static forcedinline Float abs (Float v) noexcept                       { return _mm512_abs_ps (v); }
+    static forcedinline Float min (Float a, Float b) noexcept              { return _mm512_min_ps (a, b); }
+
+    static forcedinline Float selectBelow (Float v, Float limit, Float ifBelow, Float otherwise) noexcept
+    {
+        return _mm512_mask_blend_ps (_mm512_cmp_ps_mask (v, limit, _CMP_LT_OQ), otherwise, ifBelow);
+    }
+
+   #elif defined (__AVX2__)
+    static constexpr int width = 8;
+    using Float = __m256;
+    using Int   = __m256i;
+
+    static forcedinline Float load (const float* p) noexcept               { return _mm256_load_ps (p); }
+    static forcedinline void store (float* p, Float v) noexcept            { _mm256_store_ps (p, v); }
+    static forcedinline void storeUnaligned (float* p, Float v) noexcept   { _mm256_storeu_ps (p, v); }
+    static forcedinline Int loadInt (const int32_t* p) noexcept            { return _mm256_load_si256 ((const __m256i*) p); }
+    static forcedinline void storeInt (int32_t* p, Int v) noexcept         { _mm256_store_si256 ((__m256i*) p, v); }
+    static forcedinline Float broadcast (float v) noexcept                 { return _mm256_set1_ps (v); }
+    static forcedinline Float add (Float a, Float b) noexcept              { return _mm256_add_ps (a, b); }
+    static forcedinline Float sub (Float a, Float b) noexcept              { return _mm256_sub_ps (a, b); }
+    static forcedinline Float mul (Float a, Float b) noexcept              { return _mm256_mul_ps (a, b); }
+    static forcedinline Int truncate (Float v) noexcept                    { return _mm256_cvttps_epi32 (v); }
+    static forcedinline Float toFloat (Int v) noexcept                     { return _mm256_cvtepi32_ps (v); }
+    static forcedinline Int addInt (Int a, Int b) noexcept                 { return _mm256_add_epi32 (a, b); }
+    static forcedinline Int broadcastInt (int32_t v) noexcept              { return _mm256_set1_epi32 (v); }
+    static forcedinline Float gather (const float* table, Int i) noexcept  { return _mm256_i32gather_ps (table, i, 4); }
+    template <int bits> static forcedinline Int shiftLeft (Int v) noexcept { return _mm256_slli_epi32 (v, bits); }
+
+    static forcedinline Float wrap (Float phase, Float limit) noexcept
+    {
+        auto above = _mm256_cmp_ps (phase, limit, _CMP_GT_OQ);
+        return _mm256_sub_ps (phase, _mm256_and_ps (above, limit));
+    }
+
+    static forcedinline Float div (Float a, Float b) noexcept              { return _mm256_div_ps (a, b); }
+    static forcedinline Float abs (Float v) noexcept                       { return _mm256_andnot_ps (_mm256_set1_ps (-0.0f), v); }
+    static forcedinline Float min (Float a, Float b) noexcept              { return _mm256_min_ps (a, b); }
+
+    static forcedinline Float selectBelow (Float v, Float limit, Float ifBelow, Float otherwise) noexcept
+    {
+        return _mm256_blendv_ps (otherwise, ifBelow, _mm256_cmp_ps (v, limit, _CMP_LT_OQ));
+    }
+
+   #elif FLOAT_LANES_SSE2
+    static constexpr int width = 4;
+    using Float = __m128;
+    using Int   = __m128i;
+
+    static forcedinline Float load (const float* p) noexcept               { return _mm_load_ps (p); }
+    static forcedinline void store (float* p, Float v) noexcept            { _mm_store_ps (p, v); }
+    static forcedinline void storeUnaligned (float* p, Float v) noexcept   { _mm_storeu_ps (p, v); }
+    static forcedinline Int loadInt (const int32_t* p) noexcept            { return _mm_load_si128 ((const __m128i*) p); }
+    static forcedinline void storeInt (int32_t* p, Int v) noexcept         { _mm_store_si128 ((__m128i*) p, v); }
+    static forcedinline Float broadcast (float v) noexcept                 { return _mm_set1_ps (v); }
+    static forcedinline Float add (Float a, Float b) noexcept              { return _mm_add_ps (a, b); }
+    static forcedinline Float sub (Float a, Float b) noexcept              { return _mm_sub_ps (a, b); }
+    static forcedinline Float mul (Float a, Float b) noexcept              { return _mm_mul_ps (a, b); }
+    static forcedinline Int truncate (Float v) noexcept                    { return _mm_cvttps_epi32 (v); }
+    static forcedinline Float toFloat (Int v) noexcept                     { return _mm_cvtepi32_ps (v); }
+    static forcedinline Int addInt (Int a, Int b) noexcept                 { return _mm_add_epi32 (a, b); }
+    static forcedinline Int broadcastInt (int32_t v) noexcept              { return _mm_set1_epi32 (v); }
+    template <int bits> static forcedinline Int shiftLeft (Int v) noexcept { return _mm_slli_epi32 (v, bits); }
+
+    static forcedinline Float gather (const float* table, Int i) noexcept
+    {
+        alignas (16) int32_t index[4];
+        _mm_store_si128 ((__m128i*) index, i);
+        return _mm_setr_ps (table[index[0]], table[index[1]], table[index[2]], table[index[3]]);
+    }
+
+    static forcedinline Float wrap (Float phase, Float limit) noexcept
+    {
+        auto above = _mm_cmpgt_ps (phase, limit);
+        return _mm_sub_ps (phase, _mm_and_ps (above, limit));
+    }
+
+    static forcedinline Float div (Float a, Float b) noexcept              { return _mm_div_ps (a, b); }
+    static forcedinline Float abs (Float v) noexcept                       { return _mm_andnot_ps (_mm_set1_ps (-0.0f), v); }
+    static forcedinline Float min (Float a, Float b) noexcept              { return _mm_min_ps (a, b); }
+
+    static forcedinline Float selectBelow (Float v, Float limit, Float ifBelow, Float otherwise) noexcept
+    {
+        auto below = _mm_cmplt_ps (v, limit);
+        return _mm_or_ps (_mm_and_ps (below, ifBelow), _mm_andnot_ps (below, otherwise));
+    }
+
+   #elif FLOAT_LANES_NEON
+    static constexpr int width = 4;
+    using Float = float32x4_t;
+    using Int   = int32x4_t;
+
+    static forcedinline Float load (const float* p) noexcept               { return vld1q_f32 (p); }
+    static forcedinline void store (float* p, Float v) noexcept            { vst1q_f32 (p, v); }
+    static forcedinline void storeUnaligned (float* p, Float v) noexcept   { vst1q_f32 (p, v); }
+    static forcedinline Int loadInt (const int32_t* p) noexcept            { return vld1q_s32 (p); }
+    static forcedinline void storeInt (int32_t* p, Int v) noexcept         { vst1q_s32 (p, v); }
+    static forcedinline Float broadcast (float v) noexcept                 { return vdupq_n_f32 (v); }
+    static forcedinline Float add (Float a, Float b) noexcept              { return vaddq_f32 (a, b); }
+    static forcedinline Float sub (Float a, Float b) noexcept              { return vsubq_f32 (a, b); }
+    static forcedinline Float mul (Float a, Float b) noexcept              { return vmulq_f32 (a, b); }
+    static forcedinline Int truncate (Float v) noexcept                    { return vcvtq_s32_f32 (v); }
+    static forcedinline Float toFloat (Int v) noexcept                     { return vcvtq_f32_s32 (v); }
+    static forcedinline Int addInt (Int a, Int b) noexcept                 { return vaddq_s32 (a, b); }
+    static forcedinline Int broadcastInt (int32_t v) noexcept              { return vdupq_n_s32 (v); }
+    template <int bits> static forcedinline Int shiftLeft (Int v) noexcept { return vshlq_n_s32 (v, bits); }
+
+    static forcedinline Float gather (const float* table, Int i) noexcept
+    {
+        auto result = vdupq_n_f32 (table[vgetq_lane_s32 (i, 0)]);
+        result = vsetq_lane_f32 (table[vgetq_lane_s32 (i, 1)], result, 1);
+        result = vsetq_lane_f32 (table[vgetq_lane_s32 (i, 2)], result, 2);
+        return   vsetq_lane_f32 (table[vgetq_lane_s32 (i, 3)], result, 3);
+    }
+
+    static forcedinline Float wrap (Float phase, Float limit) noexcept
+    {
+        auto above = vcgtq_f32 (phase, limit);
+        return vsubq_f32 (phase, vreinterpretq_f32_u32 (vandq_u32 (above, vreinterpretq_u32_f32 (limit))));
+    }
+
+    static forcedinline Float div (Float a, Float b) noexcept
+    {
+       #if defined (__aarch64__) || defined (_M_ARM64)
+        return vdivq_f32 (a, b);
+       #else
+        // 32-bit NEON has no divide: refine the reciprocal estimate twice.
+        auto reciprocal = vrecpeq_f32 (b);
+        reciprocal = vmulq_f32 (vrecpsq_f32 (b, reciprocal), reciprocal);
+        reciprocal = vmulq_f32 (vrecpsq_f32 (b, reciprocal), reciprocal);
+        return vmulq_f32 (a, reciprocal);
+       #endif
+    }
+
+    static forcedinline Float abs (Float v) noexcept                       { return vabsq_f32 (v); }
+    static forcedinline Float min (Float a, Float b) noexcept              { return vminq_f32 (a, b); }
+
+    static forcedinline Float selectBelow (Float v, Float limit, Float ifBelow, Float otherwise) noexcept
+    {
+        return vbslq_f32 (vcltq_f32 (v, limit), ifBelow, otherwise);
+    }
+
+   #else
+    static constexpr int width = ScalarLanes::width;
+    using Float = ScalarLanes::Float;
+    using Int   = ScalarLanes::Int;
+
+    static forcedinline Float load (const float* p) noexcept               { return ScalarLanes::load (p); }
+    static forcedinline void store (float* p, Float v) noexcept            { ScalarLanes::store (p, v); }
+    static forcedinline void storeUnaligned (float* p, Float v) noexcept   { ScalarLanes::store (p, v); }
+    static forcedinline Int loadInt (const int32_t* p) noexcept            { return ScalarLanes::loadInt (p); }
+    static forcedinline void storeInt (int32_t* p, Int v) noexcept         { ScalarLanes::storeInt (p, v); }
+    static forcedinline Float broadcast (float v) noexcept                 { return v; }
+    static forcedinline Float add (Float a, Float b) noexcept              { return a + b; }
+    static forcedinline Float sub (Float a, Float b) noexcept              { return a - b; }
+    static forcedinline Float mul (Float a, Float b) noexcept              { return a * b; }
+    static forcedinline Int truncate (Float v) noexcept                    { return (Int) v; }
+    static forcedinline Float toFloat (Int v) noexcept                     { return (Float) v; }
+    static forcedinline Int addInt (Int a, Int b) noexcept                 { return a + b; }
+    static forcedinline Int broadcastInt (int32_t v) noexcept              { return v; }
+    static forcedinline Float gather (const float* table, Int i) noexcept  { return table[i]; }
+    template <int bits> static forcedinline Int shiftLeft (Int v) noexcept { return v << bits; }
+    static forcedinline Float wrap (Float phase, Float limit) noexcept     { return ScalarLanes::wrap (phase, limit); }
+    static forcedinline Float div (Float a, Float b) noexcept              { return ScalarLanes::div (a, b); }
+    static forcedinline Float abs (Float v) noexcept                       { return ScalarLanes::abs (v); }
+    static forcedinline Float min (Float a, Float b) noexcept              { return ScalarLanes::min (a, b); }
+    static forcedinline Float selectBelow (Float v, Float limit, Float ifBelow, Float otherwise) noexcept  { return ScalarLanes::selectBelow (v, limit, ifBelow, otherwise); }
+   #endif
+
+    /** Alignment in bytes that load() and store() expect. */
+    static constexpr size_t alignment = (size_t) width * sizeof (float) < 16 ? 16 : (size_t) width * sizeof (float);
+};
+
+//==============================================================================
+/** A zero-initialised heap array whose start is aligned for FloatLanes::load(). */
+template <typename ElementType>
+class AlignedLaneArray
+{
+public:
+    AlignedLaneArray() = default;
+
+    void allocate (int numElements)
+    {
+        storage.calloc ((size_t) numElements * sizeof (ElementType) + FloatLanes::alignment);
+
+        auto address = reinterpret_cast<uintptr_t> (storage.get());
+        auto aligned = (address + FloatLanes::alignment - 1) & ~(uintptr_t) (FloatLanes::alignment - 1);
+        elements = reinterpret_cast<ElementType*> (aligned);
+        size = numElements;
+    }
+
+    forcedinline ElementType* data() const noexcept                 { return elements; }
+    forcedinline ElementType& operator[] (int index) const noexcept { return elements[index]; }
+    int getSize() const noexcept                                    { return size; }
+
+private:
+    juce::HeapBlock<char> storage;
+    ElementType* elements = nullptr;
+    int size = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (AlignedLaneArray)
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include "ImpulseResponseSpectrumFile.h"
+
+//==============================================================================
+/**
+    Keeps the impulse responses that convolvers are playing, so every
+    convolver that loads the same file at the same sample rate and
+    partitioning shares one set of partition spectra. They don't each
+    decode, resample and transform their own copy.
+
+    Entries are keyed by the file's path, modification time and size, the
+    sample rate, the length limit and the partitioning, so an edited file is
+    loaded afresh. The cache only holds weak references: a response is freed
+    once its last convolver lets go, and its entry is dropped on the next
+    lookup.
+
+    Each response is also kept on disk as an ImpulseResponseSpectrumFile in
+    the spectrum directory. A response that isn't in memory is mapped from
+    there if an up-to-date file exists, so only the first load of each WAV
+    at each rate pays for decoding and FFTs. Later instances, sessions and
+    runs start almost at once.
+
+    Hold one through a juce::SharedResourcePointer to share it across the
+    whole process. Call it from the message thread or a loader thread, not
+    from the audio thread: a miss loads the file while holding the lock.
+*/
+class ImpulseResponseCache
+{
+public:
+    /** One response per channel of the file. */
+    using Channels = std::vector<std::shared_ptr<const PartitionedImpulseResponse>>;
+
+    /** Keeps the spectrum files in the user's application data folder. */
+    ImpulseResponseCache()
+        : ImpulseResponseCache (getDefaultSpectrumDirectory())
+    {
+    }
+
+    /** Keeps the spectrum files in this directory, or only in memory if it's
+        juce::File().
+    */
+    explicit ImpulseResponseCache (const juce::File& spectrumDirectoryToUse)
+        : spectrumDirectory (spectrumDirectoryToUse)
+    {
+    }
+
+    static juce::File getDefaultSpectrumDirectory()
+    {
+        return juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory).getChildFile ("ImpulseResponseSpectra");
+    }
+
+    /** Returns the file's channels at this sample rate, reading at most
+        maxNumSamples of it, loading it on the first request. The channels
+        are normalised as juce::dsp::Convolution normalises them. Empty if
+        the file can't be read.
+    */
+    Channels getOrLoad (const juce::File& file, int maxNumSamples, double sampleRate, const ConvolutionPartitioning& partitioning)
+    {
+        auto key = ImpulseResponseSource::forFile (file, maxNumSamples, sampleRate, partitioning);
+
+        const juce::ScopedLock sl (lock);
+        removeExpiredEntries();
+
+        for (auto& entry : entries)
+            if (entry.key == key)
+                if (auto response = entry.response.lock())
+                    return getChannels (response);
+
+        auto response = load (file, key);
+
+        if (response == nullptr)
+            return {};
+
+        entries.push_back ({ key, response });
+        return getChannels (response);
+    }
+
+    /** The number of responses still in use by someone. */
+    int size() const
+    {
+        const juce::ScopedLock sl (lock);
+        auto numAlive = 0;
+
+        for (auto& entry : entries)
+            if (! entry.response.expired())
+                ++numAlive;
+
+        return numAlive;
+    }
+
+private:
+    //==============================================================================
+    /** Either mapped from a spectrum file or built here. */
+    struct Response
+    {
+        std::unique_ptr<ImpulseResponseSpectrumFile> spectrumFile;
+        ImpulseResponseSpectrumFile::Channels builtChannels;
+
+        const ImpulseResponseSpectrumFile::Channels& getChannels() const noexcept
+        {
+            return spectrumFile != nullptr ? spectrumFile->getChannels() : builtChannels;
+        }
+    };
+
+    struct Entry
+    {
+        ImpulseResponseSource key;
+        std::weak_ptr<const Response> response;
+    };
+
+    /** Each channel keeps the whole response, and with it the cache entry, alive. */
+    static Channels getChannels (const std::shared_ptr<const Response>& response)
+    {
+        Channels channels;
+
+        for (auto& channel : response->getChannels())
+            channels.emplace_back (response, channel.get());
+
+        return channels;
+    }
+
+    void removeExpiredEntries()
+    {
+        entries.erase (std::remove_if (entries.begin(), entries.end(), [] (const Entry& entry) { return entry.response.expired(); }),
+                       entries.end());
+    }
+
+    //==============================================================================
+    std::shared_ptr<const Response> load (const juce::File& file, const ImpulseResponseSource& key) const
+    {
+        auto spectrumFile = spectrumDirectory != juce::File() ? ImpulseResponseSpectrumFile::getFileFor (spectrumDirectory, key)
+                                                              : juce::File();
+
+        if (auto mapped = ImpulseResponseSpectrumFile::open (spectrumFile, key))
+        {
+            auto response = std::make_shared<Response>();
+            response->spectrumFile = std::move (mapped);
+            return response;
+        }
+
+        auto response = build (file, key);
+
+        // not being able to write the file only costs the next load some time
+        if (response != nullptr && spectrumFile != juce::File())
+            ImpulseResponseSpectrumFile::write (spectrumFile, key, response->builtChannels);
+
+        return response;
+    }
+
+    static std::shared_ptr<Response> build (const juce::File& file, const ImpulseResponseSource& key)
+    {
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (file));
+
+        if (reader == nullptr || reader->lengthInSamples == 0)
+            return {};
+
+        auto numSamples = (int) juce::jmin ((juce::int64) key.maxNumSamples, reader->lengthInSamples);
+        juce::AudioBuffer<float> buffer (juce::jlimit (1, 2, (int) reader->numChannels), numSamples);
+        reader->read (&buffer, 0, numSamples, 0, true, true);
+
+        buffer = resample (buffer, reader->sampleRate, key.sampleRate);
+        normalise (buffer);
+
+        auto response = std::make_shared<Response>();
+
+        for (auto channel = 0; channel < buffer.getNumChannels(); ++channel)
+            response->builtChannels.push_back (std::make_unique<const PartitionedImpulseResponse> (buffer.getReadPointer (channel),
+                                                                                                   buffer.getNumSamples(),
+                                                                                                   key.partitioning));
+
+        return response;
+    }
+
+    static juce::AudioBuffer<float> resample (juce::AudioBuffer<float>& buffer, double sourceRate, double destRate)
+    {
+        if (sourceRate == destRate)
+            return buffer;
+
+        auto ratio = sourceRate / destRate;
+        auto numSamples = juce::roundToInt (juce::jmax (1.0, buffer.getNumSamples() / ratio));
+
+        juce::MemoryAudioSource memorySource (buffer, false);
+        juce::ResamplingAudioSource resamplingSource (&memorySource, false, buffer.getNumChannels());
+        resamplingSource.setResamplingRatio (ratio);
+        resamplingSource.prepareToPlay (numSamples, destRate);
+
+        juce::AudioBuffer<float> resampled (buffer.getNumChannels(), numSamples);
+        resamplingSource.getNextAudioBlock ({ &resampled, 0, numSamples });
+        return resampled;
+    }
+
+    /** Scales every channel by the same factor, set by the loudest channel's energy. */
+    static void normalise (juce::AudioBuffer<float>& buffer)
+    {
+        auto maxEnergy = 0.0f;
+
+        for (auto channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* samples = buffer.getReadPointer (channel);
+            auto energy = 0.0f;
+
+            for (auto i = 0; i < buffer.getNumSamples(); ++i)
+                energy += samples[i] * samples[i];
+
+            maxEnergy = juce::jmax (maxEnergy, energy);
+        }
+
+        if (maxEnergy > 0.0f)
+            buffer.applyGain (0.125f / std::sqrt (maxEnergy));
+    }
+
+    //==============================================================================
+    juce::File spectrumDirectory;
+    juce::CriticalSection lock;
+    std::vector<Entry> entries;
+
+    JUCE_DECLARE_NON_COPYABLE (ImpulseResponseCache)
+};
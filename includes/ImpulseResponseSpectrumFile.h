@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <juce_core/juce_core.h>
+#include "PartitionedConvolver.h"
+
+//==============================================================================
+/** Everything a prepared impulse response depends on. */
+struct ImpulseResponseSource
+{
+    juce::String path;
+    juce::int64 modificationTime = 0;
+    juce::int64 fileSize = 0;
+    int maxNumSamples = 0;
+    double sampleRate = 0.0;
+    ConvolutionPartitioning partitioning;
+
+    static ImpulseResponseSource forFile (const juce::File& file, int maxNumSamples, double sampleRate,
+                                          const ConvolutionPartitioning& partitioning)
+    {
+        return { file.getFullPathName(), file.getLastModificationTime().toMilliseconds(), file.getSize(),
+                 maxNumSamples, sampleRate, partitioning };
+    }
+
+    bool operator== (const ImpulseResponseSource&) const = default;
+};
+
+//==============================================================================
+/**
+    A file holding an impulse response's partition spectra for one sample
+    rate and partitioning, exactly as PartitionedImpulseResponse keeps them.
+    Opening one maps it into memory and plays the spectra from there, so
+    there's nothing to decode, resample or transform.
+
+    The header records the source file's modification time and size, so a
+    file made from an older version of the WAV isn't opened. Each source has
+    one file name per sample rate and partitioning, and writing a new file
+    replaces the stale one.
+
+    The layout is a header padded to a multiple of 64 bytes, then for each
+    channel its head and then its spectra. Every block starts on a 64-byte
+    boundary, because the head and stride lengths are multiples of 16
+    floats. The floats are in the machine's own byte order, since the file
+    only caches work for this machine. Bump formatVersion whenever
+    PartitionedImpulseResponse's layout changes.
+*/
+class ImpulseResponseSpectrumFile
+{
+public:
+    using Channels = std::vector<std::unique_ptr<const PartitionedImpulseResponse>>;
+
+    /** Where the spectra for this source live in this directory. */
+    static juce::File getFileFor (const juce::File& directory, const ImpulseResponseSource& source)
+    {
+        auto name = source.path + "|" + juce::String (source.maxNumSamples) + "|" + juce::String (source.sampleRate)
+                      + "|" + juce::String (source.partitioning.headSize) + "|" + juce::String (source.partitioning.maxPartitionSize)
+                      + "|" + juce::String (source.partitioning.backgroundPartitionSize);
+
+        return directory.getChildFile (juce::String::toHexString (name.hashCode64()) + ".irspectra");
+    }
+
+    /** Maps the file, or returns nullptr if it's missing, damaged, or was made
+        from anything other than exactly this source.
+    */
+    static std::unique_ptr<ImpulseResponseSpectrumFile> open (const juce::File& file, const ImpulseResponseSource& source)
+    {
+        if (! file.existsAsFile())
+            return {};
+
+        auto mapping = std::make_unique<juce::MemoryMappedFile> (file, juce::MemoryMappedFile::readOnly);
+        auto* data = static_cast<const char*> (mapping->getData());
+
+        if (data == nullptr || mapping->getSize() < sizeof (Header))
+            return {};
+
+        Header header;
+        std::memcpy (&header, data, sizeof (Header));
+
+        if (! header.matches (source) || header.numChannels < 1 || header.length < 1
+             || mapping->getSize() != sizeof (Header) + header.getChannelBytes() * (size_t) header.numChannels)
+            return {};
+
+        std::unique_ptr<ImpulseResponseSpectrumFile> spectrumFile (new ImpulseResponseSpectrumFile());
+
+        for (auto channel = 0; channel < header.numChannels; ++channel)
+        {
+            auto* head = reinterpret_cast<const float*> (data + sizeof (Header) + header.getChannelBytes() * (size_t) channel);
+
+            auto response = std::make_unique<const PartitionedImpulseResponse> (header.length, source.partitioning,
+                                                                                head, head + source.partitioning.headSize);
+
+            // written by a build that laid the stages out differently
+            if (response->getSpectraSize() != header.numSpectrumFloats)
+                return {};
+
+            spectrumFile->channels.push_back (std::move (response));
+        }
+
+        spectrumFile->mapping = std::move (mapping);
+        return spectrumFile;
+    }
+
+    /** Writes the channels' spectra, replacing any file that's already there.
+        The new file is written alongside and then moved into place, so a
+        process that has the old one mapped can go on playing it.
+    */
+    static bool write (const juce::File& file, const ImpulseResponseSource& source, const Channels& channels)
+    {
+        if (channels.empty() || ! file.getParentDirectory().createDirectory())
+            return false;
+
+        auto& first = *channels.front();
+        Header header (source);
+        header.numChannels = (int) channels.size();
+        header.length = first.getLength();
+        header.numSpectrumFloats = first.getSpectraSize();
+
+        juce::TemporaryFile temp (file);
+
+        {
+            auto stream = temp.getFile().createOutputStream();
+
+            if (stream == nullptr)
+                return false;
+
+            auto ok = stream->write (&header, sizeof (Header));
+
+            for (auto& channel : channels)
+            {
+                jassert (channel->getLength() == header.length && channel->getPartitioning() == source.partitioning);
+
+                ok = ok && stream->write (channel->getHead(), (size_t) channel->getHeadSize() * sizeof (float))
+                        && stream->write (channel->getSpectra(), (size_t) channel->getSpectraSize() * sizeof (float));
+            }
+
+            stream->flush();
+
+            if (! ok || stream->getStatus().failed())
+                return false;
+        }
+
+        return temp.overwriteTargetFileWithTemporary();
+    }
+
+    //==============================================================================
+    /** One response per channel, playing straight from the mapped file. */
+    const Channels& getChannels() const noexcept    { return channels; }
+
+private:
+    //==============================================================================
+    static constexpr juce::uint32 magic = 0x53524950;   // "PIRS"
+    static constexpr juce::uint32 formatVersion = 1;
+
+    struct alignas (64) Header
+    {
+        Header() = default;
+
+        explicit Header (const ImpulseResponseSource& source)
+            : pathHash (source.path.hashCode64()),
+              modificationTime (source.modificationTime),
+              fileSize (source.fileSize),
+              sampleRate (source.sampleRate),
+              maxNumSamples (source.maxNumSamples),
+              headSize (source.partitioning.headSize),
+              maxPartitionSize (source.partitioning.maxPartitionSize),
+              backgroundPartitionSize (source.partitioning.backgroundPartitionSize)
+        {
+        }
+
+        bool matches (const ImpulseResponseSource& source) const noexcept
+        {
+            Header expected (source);
+
+            return fileMagic == magic && version == formatVersion && floatSize == sizeof (float)
+                    && pathHash == expected.pathHash
+                    && modificationTime == expected.modificationTime
+                    && fileSize == expected.fileSize
+                    && sampleRate == expected.sampleRate
+                    && maxNumSamples == expected.maxNumSamples
+                    && headSize == expected.headSize
+                    && maxPartitionSize == expected.maxPartitionSize
+                    && backgroundPartitionSize == expected.backgroundPartitionSize;
+        }
+
+        size_t getChannelBytes() const noexcept
+        {
+            return ((size_t) headSize + (size_t) juce::jmax (0, numSpectrumFloats)) * sizeof (float);
+        }
+
+        juce::uint32 fileMagic = magic, version = formatVersion, floatSize = sizeof (float);
+        juce::int64 pathHash = 0, modificationTime = 0, fileSize = 0;
+        double sampleRate = 0.0;
+        int maxNumSamples = 0, headSize = 0, maxPartitionSize = 0, backgroundPartitionSize = 0;
+        int numChannels = 0, length = 0, numSpectrumFloats = 0;
+    };
+
+    static_assert (sizeof (Header) % 64 == 0 && std::is_trivially_copyable_v<Header>);
+
+    ImpulseResponseSpectrumFile() = default;
+
+    //==============================================================================
+    // declared before the channels, which point into it
+    std::unique_ptr<juce::MemoryMappedFile> mapping;
+    Channels channels;
+
+    JUCE_DECLARE_NON_COPYABLE (ImpulseResponseSpectrumFile)
+};
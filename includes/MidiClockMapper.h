@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cmath>
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+/**
+    Maps the wall-clock time stamps of incoming MIDI onto sample positions of
+    the audio stream, so an event plays a fixed latency after it arrived.
+
+    Audio callbacks arrive with jitter, so their raw times make a poor clock.
+    This class runs them through a second-order delay-locked loop (as described
+    by Fons Adriaensen for filtering audio interrupt times). The loop tracks
+    when the current block's first sample is due, and the true number of
+    seconds per sample. The sound card's crystal drifts from the system clock,
+    and the loop follows that drift too.
+
+    An event stamped t is due at t + latency. getSampleOffset() gives its
+    position relative to the current block: negative means it is late,
+    getNumSamples() or more means it belongs to a later block. The latency
+    has to cover one block plus the callback jitter for events to land
+    exactly where they belong.
+*/
+class MidiClockMapper
+{
+public:
+    MidiClockMapper() = default;
+
+    //==============================================================================
+    /** Unlocks the loop; the next beginBlock() starts it again from scratch. */
+    void reset (double newSampleRate) noexcept
+    {
+        jassert (newSampleRate > 0.0);
+
+        sampleRate = newSampleRate;
+        secondsPerSample = 1.0 / sampleRate;
+        isLocked = false;
+        numSamples = 0;
+    }
+
+    void setLatency (double seconds) noexcept              { latency = seconds; }
+    double getLatency() const noexcept                     { return latency; }
+
+    /** The loop bandwidth: lower filters out more jitter but follows drift
+        more slowly.
+    */
+    void setBandwidth (double hertz) noexcept              { bandwidth = hertz; }
+
+    //==============================================================================
+    /** Call this at the start of every audio callback with the current time
+        in seconds, before asking for any offsets.
+    */
+    void beginBlock (double callbackTime, int numSamplesInBlock) noexcept
+    {
+        jassert (numSamplesInBlock > 0);
+
+        auto error = callbackTime - nextBlockTime;
+
+        // a glitch of more than a few blocks (or the very first block) restarts the loop
+        if (! isLocked || std::abs (error) > relockBlocks * numSamples * secondsPerSample)
+        {
+            blockTime = callbackTime;
+            secondsPerSample = 1.0 / sampleRate;
+            isLocked = true;
+            lastError = 0.0;
+        }
+        else
+        {
+            auto omega = juce::MathConstants<double>::twoPi * bandwidth * numSamples * secondsPerSample;
+
+            blockTime = nextBlockTime + juce::MathConstants<double>::sqrt2 * omega * error;
+            secondsPerSample += omega * omega * error / numSamples;
+            lastError = error;
+        }
+
+        numSamples = numSamplesInBlock;
+        nextBlockTime = blockTime + numSamples * secondsPerSample;
+    }
+
+    /** Where an event stamped timeStamp belongs, in samples from the start of
+        the current block.
+    */
+    double getSampleOffset (double timeStamp) const noexcept
+    {
+        return (timeStamp + latency - blockTime) / secondsPerSample;
+    }
+
+    int getNumSamples() const noexcept                     { return numSamples; }
+
+    /** How far the last callback was from where the loop expected it, in seconds. */
+    double getLastCallbackError() const noexcept           { return lastError; }
+
+    /** The loop's estimate of the audio device's actual sample rate. */
+    double getEstimatedSampleRate() const noexcept         { return 1.0 / secondsPerSample; }
+
+private:
+    static constexpr double relockBlocks = 4.0;
+
+    double sampleRate = 44100.0, latency = 0.0, bandwidth = 0.2;
+    double blockTime = 0.0, nextBlockTime = 0.0, secondsPerSample = 1.0 / 44100.0;
+    double lastError = 0.0;
+    int numSamples = 0;
+    bool isLocked = false;
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "MidiClockMapper.h"
+
+//==============================================================================
+/**
+    Carries timestamped MIDI messages from a MIDI input thread to the audio
+    thread, as a stand-in for juce::MidiMessageCollector that never locks or
+    allocates.
+
+    The messages go through a fixed-size ring managed by a juce::AbstractFifo,
+    so there must be exactly one thread calling push() and one calling
+    removeNextBlockOfMessages(). reset() and setLatency() can be called from
+    any thread, because they only leave a request that the reading thread
+    carries out. A message that arrives while the ring is full is dropped
+    and counted.
+
+    A MidiClockMapper places every message a fixed latency after its time
+    stamp (see setLatency()). Messages that are due in a later block stay in
+    the ring until then, and messages that are already late go at the start of
+    the block and are counted. getJitterStats() reports how far the callbacks
+    strayed from the filtered clock, and how late the late messages were.
+
+    Only short messages (up to three bytes) are queued; SysEx is dropped.
+*/
+class MidiEventQueue
+{
+public:
+    /** The ring holds one less than this many messages. */
+    static constexpr int capacity = 1024;
+
+    MidiEventQueue() = default;
+
+    //==============================================================================
+    /** Sets the sample rate and discards the messages queued so far.
+
+        The MIDI input may still be pushing, so this doesn't touch the ring or
+        the clock itself: the next removeNextBlockOfMessages() resets the clock
+        and skips the discarded messages, as only the reading side may move the
+        ring's read position.
+    */
+    void reset (double newSampleRate) noexcept
+    {
+        jassert (newSampleRate > 0.0);
+
+        pendingSampleRate.store (newSampleRate, std::memory_order_relaxed);
+        numToDiscard.store (abstractFifo.getNumReady(), std::memory_order_relaxed);
+        resetPending.store (true, std::memory_order_release);
+    }
+
+    /** How long after its time stamp a message plays. This should cover one
+        audio block plus the callback jitter. It takes effect at the next block.
+    */
+    void setLatency (double seconds) noexcept       { latency.store (seconds, std::memory_order_relaxed); }
+    double getLatency() const noexcept              { return latency.load (std::memory_order_relaxed); }
+
+    /** Queues a message that has just arrived, stamped with the time it
+        arrived in seconds (as juce::MidiInput stamps them). Call this from the
+        MIDI input thread only.
+    */
+    void push (const juce::MidiMessage& message) noexcept
+    {
+        if (message.getRawDataSize() > Event::maxSize)
+        {
+            numDropped.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+
+        int start1, size1, start2, size2;
+        abstractFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+        {
+            numDropped.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+
+        auto& event = events[(size_t) start1];
+        event.timeStamp = message.getTimeStamp();
+        event.size = (juce::uint8) message.getRawDataSize();
+        std::memcpy (event.data, message.getRawData(), (size_t) event.size);
+
+        abstractFifo.finishedWrite (size1);
+    }
+
+    /** Moves the messages that are due in this block into the buffer, at
+        sample positions from 0 to numSamples - 1. The buffer isn't cleared
+        first. Call this from the audio thread only, once per callback.
+
+        Adding events to a juce::MidiBuffer only allocates when it runs out of
+        room, so reserve getBytesNeededForBuffer() in it up front.
+    */
+    void removeNextBlockOfMessages (juce::MidiBuffer& destination, int numSamples) noexcept
+    {
+        jassert (numSamples > 0);
+
+        if (resetPending.exchange (false, std::memory_order_acquire))
+            applyReset();
+
+        clock.setLatency (latency.load (std::memory_order_relaxed));
+        clock.beginBlock (juce::Time::getMillisecondCounterHiRes() * 0.001, numSamples);
+        updateCallbackJitter (clock.getLastCallbackError());
+
+        int start1, size1, start2, size2;
+        abstractFifo.prepareToRead (abstractFifo.getNumReady(), start1, size1, start2, size2);
+
+        // the messages are in time-stamp order, so stop at the first one that's
+        // due in a later block and leave it and the rest in the ring
+        auto numTaken = 0;
+
+        auto takeDueEvents = [&] (int start, int size)
+        {
+            for (auto i = start; i < start + size; ++i)
+            {
+                auto& event = events[(size_t) i];
+                auto offset = clock.getSampleOffset (event.timeStamp);
+                auto position = juce::roundToInt (offset);
+
+                if (position >= numSamples)
+                    return false;
+
+                if (position < 0)
+                    recordLateEvent (-offset / clock.getEstimatedSampleRate());
+
+                destination.addEvent (event.data, event.size, juce::jmax (0, position));
+                ++numTaken;
+            }
+
+            return true;
+        };
+
+        if (takeDueEvents (start1, size1))
+            takeDueEvents (start2, size2);
+
+        abstractFifo.finishedRead (numTaken);
+    }
+
+    //==============================================================================
+    /** How many messages have been dropped because the ring was full. */
+    int getNumDropped() const noexcept     { return numDropped.load (std::memory_order_relaxed); }
+
+    struct JitterStats
+    {
+        double callbackRmsMicroseconds = 0.0;   // callback times against the filtered clock
+        double callbackMaxMicroseconds = 0.0;
+        int numLateEvents = 0;                  // messages that arrived too late for their slot
+        double maxLatenessMicroseconds = 0.0;
+    };
+
+    /** The timing since the last reset(). Safe to call from any thread. */
+    JitterStats getJitterStats() const noexcept
+    {
+        JitterStats stats;
+        stats.callbackRmsMicroseconds = std::sqrt (callbackMeanSquare.load (std::memory_order_relaxed)) * 1.0e6;
+        stats.callbackMaxMicroseconds = callbackMax.load (std::memory_order_relaxed) * 1.0e6;
+        stats.numLateEvents           = numLateEvents.load (std::memory_order_relaxed);
+        stats.maxLatenessMicroseconds = maxLateness.load (std::memory_order_relaxed) * 1.0e6;
+        return stats;
+    }
+
+    /** Enough MidiBuffer space for a full ring plus extraEvents more messages. */
+    static size_t getBytesNeededForBuffer (int extraEvents) noexcept
+    {
+        // a MidiBuffer stores a 32-bit position and a 16-bit size before each message
+        return (size_t) (capacity + extraEvents) * (sizeof (juce::int32) + sizeof (juce::uint16) + Event::maxSize);
+    }
+
+private:
+    //==============================================================================
+    struct Event
+    {
+        static constexpr int maxSize = 3;
+
+        double timeStamp = 0.0;
+        juce::uint8 data[maxSize] {};
+        juce::uint8 size = 0;
+    };
+
+    void applyReset() noexcept
+    {
+        clock.reset (pendingSampleRate.load (std::memory_order_relaxed));
+
+        // anything read since reset() was called has already left the ring
+        abstractFifo.finishedRead (juce::jmin (numToDiscard.load (std::memory_order_relaxed), abstractFifo.getNumReady()));
+        resetJitterStats();
+    }
+
+    void resetJitterStats() noexcept
+    {
+        callbackMeanSquare.store (0.0, std::memory_order_relaxed);
+        callbackMax.store (0.0, std::memory_order_relaxed);
+        numLateEvents.store (0, std::memory_order_relaxed);
+        maxLateness.store (0.0, std::memory_order_relaxed);
+    }
+
+    void updateCallbackJitter (double error) noexcept
+    {
+        // a slow moving average, so the figure describes the last few seconds
+        auto meanSquare = callbackMeanSquare.load (std::memory_order_relaxed);
+        callbackMeanSquare.store (meanSquare + 0.01 * (error * error - meanSquare), std::memory_order_relaxed);
+
+        if (std::abs (error) > callbackMax.load (std::memory_order_relaxed))
+            callbackMax.store (std::abs (error), std::memory_order_relaxed);
+    }
+
+    void recordLateEvent (double seconds) noexcept
+    {
+        numLateEvents.fetch_add (1, std::memory_order_relaxed);
+
+        if (seconds > maxLateness.load (std::memory_order_relaxed))
+            maxLateness.store (seconds, std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    juce::AbstractFifo abstractFifo { capacity };
+    std::array<Event, (size_t) capacity> events;
+    MidiClockMapper clock;
+
+    // handed from reset() and setLatency() to the reading thread
+    std::atomic<bool> resetPending { false };
+    std::atomic<double> pendingSampleRate { 44100.0 }, latency { 0.0 };
+    std::atomic<int> numToDiscard { 0 };
+
+    std::atomic<int> numDropped { 0 }, numLateEvents { 0 };
+    std::atomic<double> callbackMeanSquare { 0.0 }, callbackMax { 0.0 }, maxLateness { 0.0 };
+
+    JUCE_DECLARE_NON_COPYABLE (MidiEventQueue)
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+//==============================================================================
+/**
+    The output side of the apps' offline renders: the WAV file the audio can
+    go to, and the timing report printed at the end.
+*/
+struct OfflineRenderReport
+{
+    /** A stereo WAV writer that owns its stream, or nullptr if the file can't
+        be written. Any file already there is replaced.
+    */
+    static std::unique_ptr<juce::AudioFormatWriter> createWavWriter (const juce::File& file, double sampleRate, int bitsPerSample)
+    {
+        file.deleteFile();
+        auto stream = file.createOutputStream();
+
+        if (stream == nullptr)
+            return {};
+
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), sampleRate, 2, bitsPerSample, {}, 0));
+
+        if (writer != nullptr)
+            stream.release();   // the writer owns it now
+
+        return writer;
+    }
+
+    /** Prints the real-time factor, the block time percentiles against the
+        block's budget, and how many times operator new was called while
+        rendering.
+    */
+    static void print (std::vector<double> blockSeconds, juce::uint64 numAllocations, int blockSize, double sampleRate)
+    {
+        if (blockSeconds.empty())
+            return;
+
+        auto renderSeconds = 0.0;
+
+        for (auto s : blockSeconds)
+            renderSeconds += s;
+
+        std::sort (blockSeconds.begin(), blockSeconds.end());
+
+        auto percentile = [&] (double p)
+        {
+            auto index = juce::jmin (blockSeconds.size() - 1, (size_t) (p * (double) blockSeconds.size()));
+            return blockSeconds[index] * 1.0e6;
+        };
+
+        auto audioSeconds = (double) blockSeconds.size() * blockSize / sampleRate;
+
+        std::cout << blockSize << "-sample blocks, " << blockSeconds.size() << " blocks at " << sampleRate << " Hz" << std::endl
+                  << std::fixed << std::setprecision (2)
+                  << "real-time factor:  " << audioSeconds / renderSeconds << "x" << std::endl
+                  << "block time (us):   p50 " << percentile (0.5)
+                  << ", p99 " << percentile (0.99)
+                  << ", max " << blockSeconds.back() * 1.0e6
+                  << " (budget " << blockSize / sampleRate * 1.0e6 << ")" << std::endl
+                  << "allocations:       " << numAllocations << " operator new calls while rendering" << std::endl;
+    }
+};
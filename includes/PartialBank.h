@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cmath>
+#include <juce_core/juce_core.h>
+#include "FloatLanes.h"
+
+//==============================================================================
+/**
+    The harmonic partials of one note, rendered together as rotating phasors.
+
+    Partial k (counting from 1) runs at k times the fundamental. Each partial is
+    a unit complex number that is multiplied by a fixed rotation every sample,
+    and its imaginary part is the sine. That costs four multiplies and two adds
+    per partial per sample, with no std::sin and no table. The phasors live in
+    aligned arrays and FloatLanes::width partials are advanced together, like
+    the oscillators of a WavetableOscillatorBank.
+
+    Left alone, float rounding would slowly change the phasors' length and,
+    because the rounded rotation is not quite the right angle, let their
+    phases drift away from the true pitch. So each partial also keeps its phase
+    in double precision, advanced once per block, and its phasor is re-derived
+    from that after every block. This costs a cos and a sin per partial per
+    block. The error then can't build up beyond one block's worth, however long
+    the note lasts.
+
+    Partials at or above Nyquist get zero gain and their groups are skipped, so
+    a high note only pays for the partials it can actually play.
+*/
+class PartialBank
+{
+public:
+    static constexpr int laneWidth = FloatLanes::width;
+
+    PartialBank() = default;
+
+    //==============================================================================
+    /** Allocates room for the partials and sets them all to zero amplitude.
+        Blocks longer than maximumBlockSize are rendered in several passes.
+    */
+    void prepare (int maxNumPartials, int maximumBlockSize)
+    {
+        jassert (maxNumPartials > 0 && maximumBlockSize > 0);
+
+        capacity = roundUpToLanes (maxNumPartials);
+        maxBlockSize = maximumBlockSize;
+
+        reals.allocate (capacity);
+        imags.allocate (capacity);
+        rotationReals.allocate (capacity);
+        rotationImags.allocate (capacity);
+        amplitudes.allocate (capacity);
+        gains.allocate (capacity);
+        cyclePositions.calloc ((size_t) capacity);
+        laneSums.allocate (maxBlockSize * laneWidth);
+
+        numPartials = maxNumPartials;
+        numAudible = 0;
+        resetPhases();
+    }
+
+    /** The amplitude of partial k, from 1 to getNumPartials(). Partials above
+        Nyquist stay silent whatever their amplitude.
+    */
+    void setAmplitude (int partial, float amplitude) noexcept
+    {
+        jassert (partial >= 1 && partial <= numPartials);
+
+        amplitudes[partial - 1] = amplitude;
+        gains[partial - 1] = partial <= numAudible ? amplitude : 0.0f;
+    }
+
+    float getAmplitude (int partial) const noexcept     { return amplitudes[partial - 1]; }
+    int getNumPartials() const noexcept                 { return numPartials; }
+
+    /** The number of partials below Nyquist at the current frequency. */
+    int getNumAudiblePartials() const noexcept          { return numAudible; }
+
+    //==============================================================================
+    /** Changes the pitch without moving the partials' phases. */
+    void setFrequency (double fundamental, double sampleRate) noexcept
+    {
+        jassert (fundamental > 0.0 && sampleRate > 0.0);
+
+        cyclesPerSample = fundamental / sampleRate;
+        numAudible = juce::jlimit (0, numPartials, (int) std::ceil (0.5 / cyclesPerSample) - 1);
+
+        for (auto i = 0; i < numPartials; ++i)
+        {
+            auto angle = juce::MathConstants<double>::twoPi * cyclesPerSample * (i + 1);
+            rotationReals[i] = (float) std::cos (angle);
+            rotationImags[i] = (float) std::sin (angle);
+            gains[i] = i < numAudible ? amplitudes[i] : 0.0f;
+        }
+    }
+
+    /** Puts every partial back at the start of its cycle. */
+    void resetPhases() noexcept
+    {
+        for (auto i = 0; i < capacity; ++i)
+            cyclePositions[i] = 0.0;
+
+        updatePhasors();
+    }
+
+    //==============================================================================
+    /** Adds the sum of the partials, each at its amplitude, to the output. */
+    void renderNextBlock (float* output, int numSamples) noexcept
+    {
+        auto numGroups = roundUpToLanes (numAudible) / laneWidth;
+
+        while (numSamples > 0)
+        {
+            auto numThisTime = juce::jmin (numSamples, maxBlockSize);
+            juce::FloatVectorOperations::clear (laneSums.data(), numThisTime * laneWidth);
+
+            // culled lanes in the last group have zero gain, so they add nothing
+            for (auto group = 0; group < numGroups; ++group)
+                renderGroup (numThisTime, group * laneWidth);
+
+            for (auto i = 0; i < numPartials; ++i)
+            {
+                auto position = cyclePositions[i] + cyclesPerSample * (i + 1) * numThisTime;
+                cyclePositions[i] = position - std::floor (position);
+            }
+
+            updatePhasors();
+
+            for (auto sample = 0; sample < numThisTime; ++sample)
+            {
+                auto* laneSum = laneSums.data() + sample * laneWidth;
+                auto total = 0.0f;
+
+                for (auto lane = 0; lane < laneWidth; ++lane)
+                    total += laneSum[lane];
+
+                output[sample] += total;
+            }
+
+            output += numThisTime;
+            numSamples -= numThisTime;
+        }
+    }
+
+private:
+    //==============================================================================
+    static int roundUpToLanes (int n) noexcept      { return (n + laneWidth - 1) / laneWidth * laneWidth; }
+
+    void updatePhasors() noexcept
+    {
+        for (auto i = 0; i < numPartials; ++i)
+        {
+            auto angle = juce::MathConstants<double>::twoPi * cyclePositions[i];
+            reals[i] = (float) std::cos (angle);
+            imags[i] = (float) std::sin (angle);
+        }
+    }
+
+    void renderGroup (int numSamples, int first) noexcept
+    {
+        auto real = FloatLanes::load (reals.data() + first);
+        auto imag = FloatLanes::load (imags.data() + first);
+        auto rotationReal = FloatLanes::load (rotationReals.data() + first);
+        auto rotationImag = FloatLanes::load (rotationImags.data() + first);
+        auto gain = FloatLanes::load (gains.data() + first);
+
+        for (auto sample = 0; sample < numSamples; ++sample)
+        {
+            auto* laneSum = laneSums.data() + sample * laneWidth;
+            FloatLanes::store (laneSum, FloatLanes::add (FloatLanes::load (laneSum), FloatLanes::mul (imag, gain)));
+
+            auto nextReal = FloatLanes::sub (FloatLanes::mul (real, rotationReal), FloatLanes::mul (imag, rotationImag));
+            imag = FloatLanes::add (FloatLanes::mul (real, rotationImag), FloatLanes::mul (imag, rotationReal));
+            real = nextReal;
+        }
+    }
+
+    //==============================================================================
+    AlignedLaneArray<float> reals, imags, rotationReals, rotationImags, amplitudes, gains, laneSums;
+    juce::HeapBlock<double> cyclePositions;
+    double cyclesPerSample = 0.0;
+    int numPartials = 0, numAudible = 0, capacity = 0, maxBlockSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (PartialBank)
+};
@@ -0,0 +1,720 @@
+#pragma once
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <juce_dsp/juce_dsp.h>
+#include "FloatLanes.h"
+
+//==============================================================================
+/** How a PartitionedImpulseResponse is cut up. */
+struct ConvolutionPartitioning
+{
+    int headSize = 64;
+    int maxPartitionSize = 4096;
+
+    /** Stages whose partitions are at least this long are laid out to run on
+        a ConvolutionTailThread; 0 keeps them all on the audio thread.
+    */
+    int backgroundPartitionSize = 0;
+
+    bool operator== (const ConvolutionPartitioning&) const = default;
+};
+
+//==============================================================================
+/**
+    An impulse response cut up for PartitionedConvolver, which never changes
+    once it is built, so one can be shared by any number of convolvers.
+
+    The first headSize samples are the head. PartitionedConvolver runs
+    them as a direct-form FIR, so there is no latency. After the head come
+    stages of FFT partitions. The first stage's partitions are as long as the
+    head, and each later stage's are four times longer, up to the maximum
+    partition size. The last stage takes the rest of the response.
+
+    A stage with partitions of P samples starts P samples in, so its output
+    is due just as the P input samples it needs have arrived. A background
+    stage starts 2P samples in, which gives a ConvolutionTailThread a whole
+    block's worth of time to compute it.
+
+    Each partition is kept as the spectrum of a 2P-point FFT. Its bins
+    0..P are stored as a block of real parts then a block of imaginary parts,
+    each getBinStride (P) floats long and 64-byte aligned.
+*/
+class PartitionedImpulseResponse
+{
+public:
+    /** juce::dsp::FFT uses stack scratch space up to this partition size,
+        and allocates above it.
+    */
+    static constexpr int largestPartitionSize = 8192;
+
+    struct Stage
+    {
+        int partitionSize = 0;
+        int offset = 0;             // the first sample of the response it covers
+        int numPartitions = 0;
+        int firstSpectrum = 0;      // the float index of its first partition's spectrum
+        bool isBackground = false;
+
+        /** How many blocks of this stage after an input block its output is due. */
+        int getLeadBlocks() const noexcept      { return offset / partitionSize; }
+    };
+
+    //==============================================================================
+    PartitionedImpulseResponse (const float* samples, int numSamples, const ConvolutionPartitioning& partitioningToUse)
+        : length (numSamples), partitioning (partitioningToUse)
+    {
+        auto headSize = partitioning.headSize;
+
+        jassert (numSamples > 0);
+        jassert (juce::isPowerOfTwo (headSize) && headSize >= binPadding);
+        jassert (juce::isPowerOfTwo (partitioning.maxPartitionSize) && partitioning.maxPartitionSize >= headSize
+                  && partitioning.maxPartitionSize <= largestPartitionSize);
+
+        head.allocate (headSize);
+        juce::FloatVectorOperations::copy (head.data(), samples, juce::jmin (headSize, numSamples));
+
+        numSpectrumFloats = layoutStages();
+        spectra.allocate (juce::jmax (1, numSpectrumFloats));
+
+        for (auto& stage : stages)
+            for (auto i = 0; i < stage.numPartitions; ++i)
+                writeSpectrum (stage, i, samples);
+
+        headData = head.data();
+        spectraData = spectra.data();
+    }
+
+    /** Wraps a head and spectra that were built earlier, as getHead() and
+        getSpectra() return them, without copying or transforming anything.
+        This is how a response mapped from a file is played. The memory has to
+        be 64-byte aligned and outlive this object.
+    */
+    PartitionedImpulseResponse (int numSamples, const ConvolutionPartitioning& partitioningToUse,
+                                const float* headToUse, const float* spectraToUse)
+        : length (numSamples), partitioning (partitioningToUse), headData (headToUse), spectraData (spectraToUse)
+    {
+        jassert (numSamples > 0);
+        jassert (reinterpret_cast<uintptr_t> (headToUse) % FloatLanes::alignment == 0);
+        jassert (reinterpret_cast<uintptr_t> (spectraToUse) % FloatLanes::alignment == 0);
+
+        numSpectrumFloats = layoutStages();
+    }
+
+    //==============================================================================
+    int getLength() const noexcept                                  { return length; }
+    const ConvolutionPartitioning& getPartitioning() const noexcept { return partitioning; }
+    int getHeadSize() const noexcept                                { return partitioning.headSize; }
+    const float* getHead() const noexcept                           { return headData; }
+    const std::vector<Stage>& getStages() const noexcept            { return stages; }
+
+    /** Every stage's spectra back to back, getSpectraSize() floats in all. */
+    const float* getSpectra() const noexcept                        { return spectraData; }
+    int getSpectraSize() const noexcept                             { return numSpectrumFloats; }
+
+    /** The real parts of a partition's bins; the imaginary parts follow
+        getBinStride (stage.partitionSize) floats later.
+    */
+    const float* getSpectrum (const Stage& stage, int partition) const noexcept
+    {
+        return spectraData + stage.firstSpectrum + partition * 2 * getBinStride (stage.partitionSize);
+    }
+
+    /** Bins 0..P of a 2P-point FFT, padded so every block stays 64-byte aligned. */
+    static int getBinStride (int partitionSize) noexcept     { return partitionSize + binPadding; }
+
+private:
+    //==============================================================================
+    static constexpr int binPadding = 16;
+    static constexpr int stageGrowth = 4;
+
+    bool isBackground (int partitionSize) const noexcept
+    {
+        return partitioning.backgroundPartitionSize > 0
+                && partitionSize >= partitioning.backgroundPartitionSize
+                && partitionSize > partitioning.headSize;
+    }
+
+    int layoutStages()
+    {
+        auto numFloats = 0;
+
+        for (auto offset = partitioning.headSize, size = partitioning.headSize; offset < length;)
+        {
+            auto nextSize = juce::jmin (size * stageGrowth, partitioning.maxPartitionSize);
+            auto numLeft = (length - offset + size - 1) / size;
+            auto numPartitions = numLeft;
+
+            // enough partitions that the next stage starts late enough for its output to be ready
+            if (nextSize > size)
+            {
+                auto nextOffset = nextSize * (isBackground (nextSize) ? 2 : 1);
+                numPartitions = juce::jmin (numLeft, (nextOffset - offset + size - 1) / size);
+            }
+
+            stages.push_back ({ size, offset, numPartitions, numFloats, isBackground (size) });
+            numFloats += numPartitions * 2 * getBinStride (size);
+
+            offset += numPartitions * size;
+            size = nextSize;
+        }
+
+        return numFloats;
+    }
+
+    void writeSpectrum (const Stage& stage, int partition, const float* samples)
+    {
+        auto size = stage.partitionSize;
+        auto start = stage.offset + partition * size;
+
+        juce::HeapBlock<float> buffer ((size_t) size * 4, true);
+        juce::FloatVectorOperations::copy (buffer.get(), samples + start, juce::jmin (size, length - start));
+
+        juce::dsp::FFT forward (juce::findHighestSetBit ((juce::uint32) size) + 1);
+        forward.performRealOnlyForwardTransform (buffer.get(), true);
+
+        auto* real = spectra.data() + stage.firstSpectrum + partition * 2 * getBinStride (size);
+        auto* imag = real + getBinStride (size);
+
+        for (auto bin = 0; bin <= size; ++bin)
+        {
+            real[bin] = buffer[(size_t) (2 * bin)];
+            imag[bin] = buffer[(size_t) (2 * bin + 1)];
+        }
+    }
+
+    //==============================================================================
+    int length = 0;
+    ConvolutionPartitioning partitioning;
+    AlignedLaneArray<float> head, spectra;
+    const float* headData = nullptr;
+    const float* spectraData = nullptr;
+    int numSpectrumFloats = 0;
+    std::vector<Stage> stages;
+
+    JUCE_DECLARE_NON_COPYABLE (PartitionedImpulseResponse)
+};
+
+//==============================================================================
+/**
+    A real-time thread that computes the background stages of any number of
+    PartitionedConvolvers, so the audio thread only has to run their heads
+    and short partitions.
+
+    The audio thread hands over each finished input block by bumping a
+    counter and waking the thread, and never locks. A background stage's
+    output isn't due until a whole block later, so the thread goes straight
+    back to sleep instead of spinning between blocks.
+*/
+class ConvolutionTailThread  : private juce::Thread
+{
+public:
+    class Client
+    {
+    public:
+        virtual ~Client() = default;
+
+        /** Computes every background block that has been handed over. */
+        virtual void processBackgroundBlocks() noexcept = 0;
+    };
+
+    ConvolutionTailThread()
+        : juce::Thread ("Convolution tail")
+    {
+        if (! startRealtimeThread ({}))
+            startThread (juce::Thread::Priority::highest);
+    }
+
+    ~ConvolutionTailThread() override
+    {
+        signalThreadShouldExit();
+        wake();
+        stopThread (1000);
+    }
+
+    //==============================================================================
+    /** Not real-time safe: these wait for the thread to finish its current pass. */
+    void addClient (Client* client)
+    {
+        const juce::ScopedLock sl (lock);
+        clients.addIfNotAlreadyThere (client);
+    }
+
+    void removeClient (Client* client)
+    {
+        const juce::ScopedLock sl (lock);
+        clients.removeFirstMatchingValue (client);
+    }
+
+    /** Call this from the audio thread after handing over a block. */
+    void wake() noexcept
+    {
+        wakeups.fetch_add (1);
+
+        if (isSleeping.load())
+            wakeups.notify_one();
+    }
+
+private:
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            auto seen = wakeups.load();
+
+            {
+                const juce::ScopedLock sl (lock);
+
+                for (auto* client : clients)
+                    client->processBackgroundBlocks();
+            }
+
+            // a block handed over during that pass has already moved the counter on
+            isSleeping.store (true);
+
+            if (wakeups.load() == seen && ! threadShouldExit())
+                wakeups.wait (seen);
+
+            isSleeping.store (false);
+        }
+    }
+
+    juce::CriticalSection lock;
+    juce::Array<Client*> clients;
+    std::atomic<juce::uint32> wakeups { 0 };
+    std::atomic<bool> isSleeping { false };
+
+    JUCE_DECLARE_NON_COPYABLE (ConvolutionTailThread)
+};
+
+//==============================================================================
+/**
+    Convolves one channel with a PartitionedImpulseResponse, with no latency.
+
+    The head is a direct-form FIR. Each stage is a uniformly partitioned
+    overlap-save convolution with a frequency-domain delay line. Every time
+    P new samples have arrived, a stage transforms them, multiplies the
+    delay line by its partitions' spectra, and writes one block of output,
+    which is played from the stage's offset onwards. Larger partitions take
+    fewer operations per sample but arrive later, which is why they only
+    cover the later part of the response.
+
+    With a ConvolutionTailThread, the background stages are handed to it
+    through per-stage rings of input and output blocks, so the audio thread's
+    cost per block stays the same however long the response is. If a
+    background block isn't ready when it is due, the audio thread spins
+    briefly for it and then plays on without that stage's output, counting
+    the block as late, so a starved tail thread costs a dropout rather than
+    a hung callback. setNonRealtime() makes it wait instead, for offline
+    rendering. Without a thread, every stage runs on the audio thread when
+    its block is complete, so the cost jumps whenever a long partition
+    comes due.
+
+    process() works in place, in blocks of any size, and never allocates.
+*/
+class PartitionedConvolver  : private ConvolutionTailThread::Client
+{
+public:
+    PartitionedConvolver() = default;
+
+    ~PartitionedConvolver() override
+    {
+        if (tailThread != nullptr)
+            tailThread->removeClient (this);
+    }
+
+    //==============================================================================
+    /** Allocates everything for the response and clears the state. Not
+        real-time safe. The background stages run on the tail thread if one
+        is given, which must outlive this convolver.
+    */
+    void setImpulseResponse (std::shared_ptr<const PartitionedImpulseResponse> newResponse,
+                             ConvolutionTailThread* tailThreadToUse = nullptr)
+    {
+        jassert (newResponse != nullptr);
+
+        if (tailThread != nullptr)
+            tailThread->removeClient (this);
+
+        response = std::move (newResponse);
+        headSize = response->getHeadSize();
+        headInput.allocate (headSize * 2);
+
+        stages.clear();
+        tailThread = nullptr;
+
+        for (auto& layout : response->getStages())
+        {
+            stages.add (new Stage (*response, layout));
+
+            if (layout.isBackground)
+                tailThread = tailThreadToUse;
+        }
+
+        reset();
+
+        if (tailThread != nullptr)
+            tailThread->addClient (this);
+    }
+
+    const PartitionedImpulseResponse* getImpulseResponse() const noexcept   { return response.get(); }
+
+    /** Clears the state, waiting for the tail thread to finish any blocks it
+        has been handed first. Not real-time safe.
+    */
+    void reset() noexcept
+    {
+        if (response == nullptr)
+            return;
+
+        juce::FloatVectorOperations::clear (headInput.data(), headInput.getSize());
+
+        for (auto* stage : stages)
+        {
+            if (runsInBackground (*stage))
+                stage->waitForBlocksDone (stage->blocksWritten.load());
+
+            stage->reset();
+        }
+
+        samplesProcessed = 0;
+    }
+
+    //==============================================================================
+    /** Convolves numSamples samples; input and output may be the same. */
+    void process (const float* input, float* output, int numSamples) noexcept
+    {
+        if (response == nullptr)
+        {
+            if (input != output)
+                juce::FloatVectorOperations::copy (output, input, numSamples);
+
+            return;
+        }
+
+        while (numSamples > 0)
+        {
+            // work up to the end of the current head block, which is never
+            // past the end of any stage's block
+            auto position = (int) (samplesProcessed & (juce::uint64) (headSize - 1));
+            auto numThisTime = juce::jmin (numSamples, headSize - position);
+
+            juce::FloatVectorOperations::copy (headInput.data() + headSize + position, input, numThisTime);
+
+            for (auto* stage : stages)
+                stage->write (input, samplesProcessed, numThisTime);
+
+            processHead (output, position, numThisTime);
+
+            for (auto* stage : stages)
+                stage->addOutput (output, samplesProcessed, numThisTime, nonRealtime, numLateBlocks);
+
+            samplesProcessed += (juce::uint64) numThisTime;
+            input += numThisTime;
+            output += numThisTime;
+            numSamples -= numThisTime;
+
+            if (position + numThisTime == headSize)
+            {
+                juce::FloatVectorOperations::copy (headInput.data(), headInput.data() + headSize, headSize);
+                finishBlocks();
+            }
+        }
+    }
+
+    /** How many background blocks weren't ready when they were due. */
+    int getNumLateBlocks() const noexcept       { return numLateBlocks.load (std::memory_order_relaxed); }
+
+    /** When rendering offline, process() waits for late background blocks
+        however long they take, so nothing is dropped.
+    */
+    void setNonRealtime (bool isNonRealtime) noexcept   { nonRealtime = isNonRealtime; }
+
+    //==============================================================================
+    /** Adds a * b to acc for numBins complex bins held as separate real and
+        imaginary blocks, which must be aligned for FloatLanes::load().
+    */
+    static void multiplyAccumulate (float* accReal, float* accImag,
+                                    const float* aReal, const float* aImag,
+                                    const float* bReal, const float* bImag, int numBins) noexcept
+    {
+        using Lanes = FloatLanes;
+        auto bin = 0;
+
+        for (; bin + Lanes::width <= numBins; bin += Lanes::width)
+        {
+            auto ar = Lanes::load (aReal + bin), ai = Lanes::load (aImag + bin);
+            auto br = Lanes::load (bReal + bin), bi = Lanes::load (bImag + bin);
+
+            auto real = Lanes::sub (Lanes::mul (ar, br), Lanes::mul (ai, bi));
+            auto imag = Lanes::add (Lanes::mul (ar, bi), Lanes::mul (ai, br));
+
+            Lanes::store (accReal + bin, Lanes::add (Lanes::load (accReal + bin), real));
+            Lanes::store (accImag + bin, Lanes::add (Lanes::load (accImag + bin), imag));
+        }
+
+        for (; bin < numBins; ++bin)
+        {
+            accReal[bin] += aReal[bin] * bReal[bin] - aImag[bin] * bImag[bin];
+            accImag[bin] += aReal[bin] * bImag[bin] + aImag[bin] * bReal[bin];
+        }
+    }
+
+private:
+    // a few tens of microseconds on current CPUs, a small part of any callback
+    static constexpr int maxSpinsForLateBlock = 1000;
+
+    //==============================================================================
+    /** One uniformly partitioned overlap-save convolution.
+
+        Input and output go through rings of blocks of P samples. Output
+        block k is the convolution of input blocks k - 1 and k, and is
+        played offset samples after input block k started. The rings hold
+        enough blocks for the audio thread to keep writing input and reading
+        output while block k is being computed on another thread.
+    */
+    struct Stage
+    {
+        Stage (const PartitionedImpulseResponse& responseToUse, const PartitionedImpulseResponse::Stage& stageLayout)
+            : response (responseToUse),
+              layout (stageLayout),
+              size (stageLayout.partitionSize),
+              binStride (PartitionedImpulseResponse::getBinStride (stageLayout.partitionSize)),
+              numSlots (stageLayout.getLeadBlocks() + 2),
+              fft (juce::findHighestSetBit ((juce::uint32) stageLayout.partitionSize) + 1)
+        {
+            input.allocate (numSlots * size);
+            output.allocate (numSlots * size);
+            fftBuffer.allocate (size * 4);
+            delayLine.allocate (layout.numPartitions * 2 * binStride);
+            accumulator.allocate (2 * binStride);
+        }
+
+        void reset() noexcept
+        {
+            juce::FloatVectorOperations::clear (input.data(), input.getSize());
+            juce::FloatVectorOperations::clear (output.data(), output.getSize());
+            juce::FloatVectorOperations::clear (delayLine.data(), delayLine.getSize());
+            newest = 0;
+            lastLateBlock = std::numeric_limits<juce::uint64>::max();
+            blocksWritten.store (0);
+            blocksDone.store (0);
+        }
+
+        //==============================================================================
+        /** Copies new samples into the input block they belong to. */
+        void write (const float* samples, juce::uint64 samplesProcessed, int numSamples) noexcept
+        {
+            juce::FloatVectorOperations::copy (getSlot (input, samplesProcessed / (juce::uint64) size)
+                                                   + (int) (samplesProcessed % (juce::uint64) size),
+                                               samples, numSamples);
+        }
+
+        /** Adds the output due at these samples. If its block hasn't been
+            computed yet, this spins for it a little and then leaves these
+            samples out, unless it has been told to wait.
+        */
+        void addOutput (float* destination, juce::uint64 samplesProcessed, int numSamples,
+                        bool waitIfLate, std::atomic<int>& numLate) noexcept
+        {
+            if (samplesProcessed < (juce::uint64) layout.offset)
+                return;
+
+            auto block = (samplesProcessed - (juce::uint64) layout.offset) / (juce::uint64) size;
+
+            if (blocksDone.load (std::memory_order_acquire) <= block)
+            {
+                // counted once, however many callbacks the block is late for
+                if (block != lastLateBlock)
+                {
+                    lastLateBlock = block;
+                    numLate.fetch_add (1, std::memory_order_relaxed);
+                }
+
+                if (waitIfLate)
+                    waitForBlocksDone (block + 1);
+                else if (! spinForBlocksDone (block + 1))
+                    return;
+            }
+
+            juce::FloatVectorOperations::add (destination,
+                                              getSlot (output, block) + (int) (samplesProcessed % (juce::uint64) size),
+                                              numSamples);
+        }
+
+        bool isBlockComplete (juce::uint64 samplesProcessed) const noexcept
+        {
+            return samplesProcessed % (juce::uint64) size == 0;
+        }
+
+        void waitForBlocksDone (juce::uint64 numBlocks) const noexcept
+        {
+            while (blocksDone.load (std::memory_order_acquire) < numBlocks)
+                pause();
+        }
+
+        /** Gives a block that is nearly done a few microseconds to arrive. */
+        bool spinForBlocksDone (juce::uint64 numBlocks) const noexcept
+        {
+            for (auto spin = 0; spin < maxSpinsForLateBlock; ++spin)
+            {
+                if (blocksDone.load (std::memory_order_acquire) >= numBlocks)
+                    return true;
+
+                pause();
+            }
+
+            return blocksDone.load (std::memory_order_acquire) >= numBlocks;
+        }
+
+        //==============================================================================
+        /** Computes every block that has been written but not done yet. */
+        void processWrittenBlocks() noexcept
+        {
+            auto done = blocksDone.load (std::memory_order_relaxed);
+            auto written = blocksWritten.load (std::memory_order_acquire);
+
+            for (; done < written; ++done)
+            {
+                convolveBlock (done);
+                blocksDone.store (done + 1, std::memory_order_release);
+            }
+        }
+
+        void convolveBlock (juce::uint64 block) noexcept
+        {
+            auto* buffer = fftBuffer.data();
+
+            // forward transform of input blocks k - 1 and k into the newest delay line slot
+            newest = (newest + 1) % layout.numPartitions;
+            auto* newReal = delayLine.data() + newest * 2 * binStride;
+            auto* newImag = newReal + binStride;
+
+            juce::FloatVectorOperations::copy (buffer, getSlot (input, block + (juce::uint64) numSlots - 1), size);
+            juce::FloatVectorOperations::copy (buffer + size, getSlot (input, block), size);
+            fft.performRealOnlyForwardTransform (buffer, true);
+
+            for (auto bin = 0; bin <= size; ++bin)
+            {
+                newReal[bin] = buffer[2 * bin];
+                newImag[bin] = buffer[2 * bin + 1];
+            }
+
+            // multiply every slot by its partition, newest input with the first partition
+            auto* accReal = accumulator.data();
+            auto* accImag = accReal + binStride;
+            juce::FloatVectorOperations::clear (accReal, 2 * binStride);
+
+            for (auto partition = 0, slot = newest; partition < layout.numPartitions; ++partition)
+            {
+                auto* real = delayLine.data() + slot * 2 * binStride;
+                auto* spectrum = response.getSpectrum (layout, partition);
+
+                multiplyAccumulate (accReal, accImag, real, real + binStride, spectrum, spectrum + binStride, size + 1);
+                slot = slot > 0 ? slot - 1 : layout.numPartitions - 1;
+            }
+
+            for (auto bin = 0; bin <= size; ++bin)
+            {
+                buffer[2 * bin]     = accReal[bin];
+                buffer[2 * bin + 1] = accImag[bin];
+            }
+
+            fft.performRealOnlyInverseTransform (buffer);
+
+            // the second half is the valid part of the circular convolution
+            juce::FloatVectorOperations::copy (getSlot (output, block), buffer + size, size);
+        }
+
+        float* getSlot (const AlignedLaneArray<float>& ring, juce::uint64 block) const noexcept
+        {
+            return ring.data() + (int) (block % (juce::uint64) numSlots) * size;
+        }
+
+        static void pause() noexcept
+        {
+           #if defined (__SSE2__) || defined (_M_X64)
+            _mm_pause();
+           #elif defined (__aarch64__)
+            __asm__ __volatile__ ("yield");
+           #else
+            std::this_thread::yield();
+           #endif
+        }
+
+        //==============================================================================
+        const PartitionedImpulseResponse& response;
+        const PartitionedImpulseResponse::Stage layout;
+        const int size, binStride, numSlots;
+        int newest = 0;
+        juce::uint64 lastLateBlock = std::numeric_limits<juce::uint64>::max();
+        juce::dsp::FFT fft;
+        AlignedLaneArray<float> input, output, fftBuffer, delayLine, accumulator;
+
+        // written by the audio thread, and by whichever thread computes the blocks
+        std::atomic<juce::uint64> blocksWritten { 0 }, blocksDone { 0 };
+    };
+
+    //==============================================================================
+    bool runsInBackground (const Stage& stage) const noexcept
+    {
+        return tailThread != nullptr && stage.layout.isBackground;
+    }
+
+    /** Hands over or computes the stages whose block has just been completed. */
+    void finishBlocks() noexcept
+    {
+        auto handedOver = false;
+
+        for (auto* stage : stages)
+        {
+            if (! stage->isBlockComplete (samplesProcessed))
+                continue;
+
+            stage->blocksWritten.store (samplesProcessed / (juce::uint64) stage->size, std::memory_order_release);
+
+            if (runsInBackground (*stage))
+                handedOver = true;
+            else
+                stage->processWrittenBlocks();
+        }
+
+        if (handedOver)
+            tailThread->wake();
+    }
+
+    void processBackgroundBlocks() noexcept override
+    {
+        for (auto* stage : stages)
+            if (runsInBackground (*stage))
+                stage->processWrittenBlocks();
+    }
+
+    void processHead (float* output, int position, int numSamples) const noexcept
+    {
+        // output[i] = sum of h[j] * x[i - j], a tap at a time across the block
+        auto* taps = response->getHead();
+        auto* newest = headInput.data() + headSize + position;
+
+        juce::FloatVectorOperations::copyWithMultiply (output, newest, taps[0], numSamples);
+
+        for (auto tap = 1; tap < headSize; ++tap)
+            if (taps[tap] != 0.0f)
+                juce::FloatVectorOperations::addWithMultiply (output, newest - tap, taps[tap], numSamples);
+    }
+
+    //==============================================================================
+    std::shared_ptr<const PartitionedImpulseResponse> response;
+    juce::OwnedArray<Stage> stages;
+    ConvolutionTailThread* tailThread = nullptr;
+    AlignedLaneArray<float> headInput;
+    int headSize = 0;
+    juce::uint64 samplesProcessed = 0;
+    bool nonRealtime = false;
+    std::atomic<int> numLateBlocks { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (PartitionedConvolver)
+};
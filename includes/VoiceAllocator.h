@@ -0,0 +1,374 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <juce_core/juce_core.h>
+#include "ActiveVoiceList.h"
+
+//==============================================================================
+/**
+    Decides which voice plays each new note, and which one gives way when they
+    are all busy, without ever searching through the voices.
+
+    Every voice is free, held (its note is down, or kept on by a pedal) or
+    released (its note is up and its tail is still sounding). The free voices
+    are a stack. The held and released voices are each kept in a list in the
+    order they got there, so the oldest is always at the front. Each voice is
+    also linked into a list per channel and note, and a held voice into a list
+    per level band. Every list is threaded through per-voice links, so moving
+    a voice between them is O(1).
+
+    At most getPolyphony() notes are held at once. A note beyond that releases
+    a held one, chosen by the StealingPolicy, so it fades out over its own
+    release instead of being cut. The voices above the polyphony are left over
+    for those fading tails. Only when no voice at all is free is one cut short,
+    and then the oldest released voice goes first, since it is fading anyway.
+
+    All the storage is allocated in prepare(), so everything else can be
+    called from the audio thread.
+*/
+class VoiceAllocator
+{
+public:
+    enum class StealingPolicy
+    {
+        oldest,     // the note that has been held the longest
+        quietest,   // the held note with the lowest level, see setLevel()
+        sameNote    // a voice already on the same note and channel, otherwise the oldest
+    };
+
+    static constexpr int noVoice = -1;
+
+    /** Levels are sorted into bands this many dB wide, from -90 dB up. */
+    static constexpr int numLevelBands = 16;
+    static constexpr float levelBandDecibels = 6.0f;
+
+    struct Allocation
+    {
+        int voice = noVoice;            // the voice to start the note on
+        int voiceToRelease = noVoice;   // a held voice to release to stay within the polyphony
+    };
+
+    VoiceAllocator() = default;
+
+    //==============================================================================
+    /** Makes every voice free. At most maxHeldNotes notes are held at once, and
+        the other voices are kept for the tails of the notes that gave way.
+    */
+    void prepare (int numVoicesToUse, int maxHeldNotes)
+    {
+        jassert (numVoicesToUse >= 0);
+
+        numVoices = numVoicesToUse;
+        polyphony = juce::jlimit (juce::jmin (1, numVoices), numVoices, maxHeldNotes);
+
+        auto size = (size_t) juce::jmax (1, numVoices);
+        freeVoices.malloc (size);
+        states.malloc (size);
+        channels.malloc (size);
+        notes.malloc (size);
+        bands.malloc (size);
+
+        ageLinks.prepare (numVoices);
+        noteLinks.prepare (numVoices);
+        bandLinks.prepare (numVoices);
+        sounding.prepare (numVoices);
+
+        clear();
+    }
+
+    void clear() noexcept
+    {
+        numFree = 0;
+
+        for (auto voice = numVoices; --voice >= 0;)
+        {
+            states[voice] = State::free;
+            freeVoices[numFree++] = voice;
+        }
+
+        held = {};
+        released = {};
+
+        for (auto& list : noteLists)
+            list = {};
+
+        for (auto& list : bandLists)
+            list = {};
+
+        numHeld = 0;
+        sounding.clear();
+    }
+
+    void setStealingPolicy (StealingPolicy newPolicy) noexcept      { policy = newPolicy; }
+    StealingPolicy getStealingPolicy() const noexcept               { return policy; }
+
+    int getNumVoices() const noexcept                               { return numVoices; }
+    int getPolyphony() const noexcept                               { return polyphony; }
+
+    //==============================================================================
+    /** Picks a voice for a note-on and marks it held on that note.
+
+        If the polyphony is used up, a held voice is chosen by the policy and
+        marked released; the caller should let it tail off. With canSteal false
+        nothing is released or cut, and noVoice is returned when none is free.
+    */
+    Allocation allocate (int midiChannel, int midiNoteNumber, bool canSteal = true) noexcept
+    {
+        jassert (isValidNote (midiChannel, midiNoteNumber));
+
+        Allocation allocation;
+
+        if (numVoices == 0)
+            return allocation;
+
+        if (canSteal && policy == StealingPolicy::sameNote)
+        {
+            // the newest voice on this note simply starts over
+            allocation.voice = noteLists[noteIndex (midiChannel, midiNoteNumber)].tail;
+
+            if (allocation.voice != noVoice)
+                remove (allocation.voice);
+        }
+
+        if (canSteal && numHeld >= polyphony && numHeld > 0)
+        {
+            allocation.voiceToRelease = chooseHeldVoice();
+            release (allocation.voiceToRelease);
+        }
+
+        if (allocation.voice == noVoice)
+        {
+            if (numFree > 0)
+            {
+                allocation.voice = freeVoices[--numFree];
+            }
+            else if (canSteal)
+            {
+                allocation.voice = released.head != noVoice ? released.head : chooseHeldVoice();
+
+                if (allocation.voice == allocation.voiceToRelease)
+                    allocation.voiceToRelease = noVoice;
+
+                remove (allocation.voice);
+            }
+            else
+            {
+                return allocation;
+            }
+        }
+
+        hold (allocation.voice, midiChannel, midiNoteNumber);
+        return allocation;
+    }
+
+    /** Marks a held voice as released, when its note-off arrives. */
+    void release (int voice) noexcept
+    {
+        jassert (juce::isPositiveAndBelow (voice, numVoices));
+
+        if (states[voice] != State::held)
+            return;
+
+        ageLinks.remove (held, voice);
+        bandLinks.remove (bandLists[(size_t) bands[voice]], voice);
+        --numHeld;
+
+        states[voice] = State::released;
+        ageLinks.pushBack (released, voice);
+    }
+
+    /** Returns a voice to the free stack once it has stopped sounding. */
+    void free (int voice) noexcept
+    {
+        jassert (juce::isPositiveAndBelow (voice, numVoices));
+
+        if (states[voice] == State::free)
+            return;
+
+        remove (voice);
+        freeVoices[numFree++] = voice;
+    }
+
+    /** Tells the allocator how loud a held voice is now, as a linear gain, for
+        the quietest policy. A voice that never reports a level counts as loud.
+    */
+    void setLevel (int voice, float gain) noexcept
+    {
+        jassert (juce::isPositiveAndBelow (voice, numVoices));
+
+        if (states[voice] != State::held)
+            return;
+
+        auto band = getLevelBand (gain);
+
+        if (band != bands[voice])
+        {
+            bandLinks.remove (bandLists[(size_t) bands[voice]], voice);
+            bands[voice] = band;
+            bandLinks.pushBack (bandLists[(size_t) band], voice);
+        }
+    }
+
+    static int getLevelBand (float gain) noexcept
+    {
+        if (gain <= 0.0f)
+            return 0;
+
+        auto band = (20.0f * std::log10 (gain) + levelBandDecibels * (float) numLevelBands) / levelBandDecibels;
+        return juce::jlimit (0, numLevelBands - 1, (int) band);
+    }
+
+    //==============================================================================
+    bool isFree (int voice) const noexcept          { return states[voice] == State::free; }
+    bool isHeld (int voice) const noexcept          { return states[voice] == State::held; }
+    bool isReleased (int voice) const noexcept      { return states[voice] == State::released; }
+
+    int getNumFree() const noexcept                 { return numFree; }
+    int getNumHeld() const noexcept                 { return numHeld; }
+
+    /** The voices that are held or released, in no particular order. */
+    const ActiveVoiceList& getSoundingVoices() const noexcept    { return sounding; }
+
+    /** The voices on a note, oldest first: iterate with getNextVoiceOnNote()
+        until it returns noVoice. Releasing a voice doesn't disturb this.
+    */
+    int getFirstVoiceOnNote (int midiChannel, int midiNoteNumber) const noexcept
+    {
+        jassert (isValidNote (midiChannel, midiNoteNumber));
+        return noteLists[noteIndex (midiChannel, midiNoteNumber)].head;
+    }
+
+    int getNextVoiceOnNote (int voice) const noexcept   { return noteLinks.next[voice]; }
+
+    int getChannel (int voice) const noexcept           { return channels[voice]; }
+    int getNote (int voice) const noexcept              { return notes[voice]; }
+
+private:
+    //==============================================================================
+    enum class State : juce::uint8
+    {
+        free,
+        held,
+        released
+    };
+
+    struct List
+    {
+        int head = noVoice, tail = noVoice;
+    };
+
+    /** The next and previous pointers for one family of lists, which a voice
+        can be in at most one of at a time.
+    */
+    struct Links
+    {
+        void prepare (int numVoicesToLink)
+        {
+            next.malloc ((size_t) juce::jmax (1, numVoicesToLink));
+            previous.malloc ((size_t) juce::jmax (1, numVoicesToLink));
+        }
+
+        void pushBack (List& list, int voice) noexcept
+        {
+            previous[voice] = list.tail;
+            next[voice] = noVoice;
+
+            if (list.tail != noVoice)
+                next[list.tail] = voice;
+            else
+                list.head = voice;
+
+            list.tail = voice;
+        }
+
+        void remove (List& list, int voice) noexcept
+        {
+            if (previous[voice] != noVoice)
+                next[previous[voice]] = next[voice];
+            else
+                list.head = next[voice];
+
+            if (next[voice] != noVoice)
+                previous[next[voice]] = previous[voice];
+            else
+                list.tail = previous[voice];
+        }
+
+        juce::HeapBlock<int> next, previous;
+    };
+
+    static constexpr int numChannels = 16, numNotes = 128;
+
+    static bool isValidNote (int midiChannel, int midiNoteNumber) noexcept
+    {
+        return midiChannel >= 1 && midiChannel <= numChannels && juce::isPositiveAndBelow (midiNoteNumber, numNotes);
+    }
+
+    static size_t noteIndex (int midiChannel, int midiNoteNumber) noexcept
+    {
+        return (size_t) ((midiChannel - 1) * numNotes + midiNoteNumber);
+    }
+
+    int chooseHeldVoice() const noexcept
+    {
+        jassert (numHeld > 0);
+
+        if (policy == StealingPolicy::quietest)
+            for (auto& list : bandLists)
+                if (list.head != noVoice)
+                    return list.head;
+
+        return held.head;
+    }
+
+    void hold (int voice, int midiChannel, int midiNoteNumber) noexcept
+    {
+        states[voice] = State::held;
+        channels[voice] = midiChannel;
+        notes[voice] = midiNoteNumber;
+        bands[voice] = numLevelBands - 1;
+
+        ageLinks.pushBack (held, voice);
+        noteLinks.pushBack (noteLists[noteIndex (midiChannel, midiNoteNumber)], voice);
+        bandLinks.pushBack (bandLists[(size_t) bands[voice]], voice);
+        ++numHeld;
+
+        sounding.add (voice);
+    }
+
+    /** Takes a held or released voice out of all its lists. */
+    void remove (int voice) noexcept
+    {
+        if (states[voice] == State::held)
+        {
+            ageLinks.remove (held, voice);
+            bandLinks.remove (bandLists[(size_t) bands[voice]], voice);
+            --numHeld;
+        }
+        else
+        {
+            ageLinks.remove (released, voice);
+        }
+
+        noteLinks.remove (noteLists[noteIndex (channels[voice], notes[voice])], voice);
+        sounding.remove (voice);
+        states[voice] = State::free;
+    }
+
+    //==============================================================================
+    StealingPolicy policy = StealingPolicy::oldest;
+    int numVoices = 0, polyphony = 0, numFree = 0, numHeld = 0;
+
+    juce::HeapBlock<int> freeVoices, channels, notes, bands;
+    juce::HeapBlock<State> states;
+
+    Links ageLinks, noteLinks, bandLinks;
+    List held, released;
+    std::array<List, (size_t) (numChannels * numNotes)> noteLists;
+    std::array<List, (size_t) numLevelBands> bandLists;
+
+    ActiveVoiceList sounding;
+
+    JUCE_DECLARE_NON_COPYABLE (VoiceAllocator)
+};